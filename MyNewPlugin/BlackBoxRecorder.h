@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+/** A flight recorder for the synth engine: a fixed-size ring of the most recent MIDI messages, voice settings changes, processed blocks
+ *  and sample rate/block size resets, in the order the engine saw them. Dumped to a file after a dropout or a stuck note, it can be fed
+ *  back through an offline engine block by block (see the headless runner's --replay) to reproduce exactly what the plug-in rendered.
+ *  Recording is wait-free and never allocates, and any thread can record: each writer claims a slot with one atomic increment, and
+ *  a per-slot sequence number lets the reader skip slots that were being overwritten while it copied them. */
+class BlackBoxRecorder
+{
+public:
+  enum EEventType : uint32_t
+  {
+    kEventNone = 0,
+    kEventReset, // a sample rate/block size change, or the once a second keyframe repeating them, mValues[0] = sample rate, mData = block size
+    kEventMidi, // mData = status << 16 | data1 << 8 | data2, mValues[0] = offset
+    kEventSettings, // mValues = attack ms, decay ms, sustain level, release ms, mData = ramp samples
+    kEventBlock, // mData = frames, mValues[0] = microseconds the block took to process, recorded after it was rendered
+    kEventHardReset, // all voices stopped and held keys forgotten
+    kEventRetriggerMode, // mData = MySynthVoice::ERetriggerMode, on a change and in the once a second keyframe
+  };
+
+  struct Event
+  {
+    int64_t mSampleTime; // the engine's sample position at the start of the block the event belongs to
+    uint32_t mType;
+    uint32_t mData;
+    double mValues[4];
+  };
+
+  static constexpr uint32_t kFileMagic = 'MNBB';
+  static constexpr uint32_t kFileVersion = 1;
+
+  /** @param capacity The number of events kept, rounded up to a power of two. At 64 sample blocks a block event is written 750 times a second at 48kHz */
+  BlackBoxRecorder(int capacity = 1 << 15)
+  {
+    mSize = 1;
+
+    while (mSize < (uint64_t) capacity)
+      mSize <<= 1;
+  }
+
+  /** The ring is allocated the first time recording is enabled, so engines that never record don't pay for it. Call from a non-realtime thread */
+  void SetEnabled(bool enabled)
+  {
+    if (enabled && !mSlots)
+      mSlots.reset(new Slot[mSize]);
+
+    mEnabled.store(enabled, std::memory_order_release);
+  }
+
+  bool GetEnabled() const { return mEnabled.load(std::memory_order_acquire); }
+
+  void Record(uint32_t type, int64_t sampleTime, uint32_t data, double v0 = 0., double v1 = 0., double v2 = 0., double v3 = 0.)
+  {
+    if (!GetEnabled())
+      return;
+
+    const uint64_t idx = mHead.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = mSlots[idx & (mSize - 1)];
+
+    slot.mSeq.store(0, std::memory_order_relaxed); // being written
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.mEvent = {sampleTime, type, data, {v0, v1, v2, v3}};
+    slot.mSeq.store(idx + 1, std::memory_order_release);
+  }
+
+  /** Flag a missed deadline from the audio thread, so that a non-realtime thread can dump the recording with TakeDeadlineMiss() */
+  void MarkDeadlineMiss() { mDeadlineMissed.store(true, std::memory_order_relaxed); }
+
+  bool TakeDeadlineMiss() { return mDeadlineMissed.exchange(false, std::memory_order_relaxed); }
+
+  /** Copy out the recording, oldest first. Call from a non-realtime thread, it allocates
+   * @param seconds If > 0 only events from this many seconds before the most recent one are kept
+   * @param sampleRate Used to convert seconds to samples */
+  std::vector<Event> Snapshot(double seconds = 0., double sampleRate = 44100.) const
+  {
+    std::vector<Event> events;
+
+    if (!mSlots)
+      return events;
+
+    const uint64_t head = mHead.load(std::memory_order_acquire);
+    const uint64_t start = head > mSize ? head - mSize : 0;
+
+    events.reserve((size_t) (head - start));
+
+    for (uint64_t idx = start; idx < head; idx++)
+    {
+      const Slot& slot = mSlots[idx & (mSize - 1)];
+
+      if (slot.mSeq.load(std::memory_order_acquire) != idx + 1)
+        continue; // not written yet, or already overwritten by a newer event
+
+      const Event event = slot.mEvent;
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      if (slot.mSeq.load(std::memory_order_relaxed) == idx + 1)
+        events.push_back(event);
+    }
+
+    if (seconds > 0. && !events.empty())
+    {
+      const int64_t from = events.back().mSampleTime - static_cast<int64_t>(seconds * sampleRate);
+      size_t first = 0;
+
+      while (first < events.size() && events[first].mSampleTime < from)
+        first++;
+
+      events.erase(events.begin(), events.begin() + first);
+    }
+
+    return events;
+  }
+
+  /** Write a recording to a file: magic, version, event count and size, then the events in native byte order
+   * @return \c true on success */
+  static bool Write(const char* path, const std::vector<Event>& events)
+  {
+    FILE* pFile = fopen(path, "wb");
+
+    if (!pFile)
+      return false;
+
+    const uint32_t header[4] = {kFileMagic, kFileVersion, static_cast<uint32_t>(events.size()), static_cast<uint32_t>(sizeof(Event))};
+    bool ok = fwrite(header, sizeof(header), 1, pFile) == 1;
+
+    if (ok && !events.empty())
+      ok = fwrite(events.data(), sizeof(Event), events.size(), pFile) == events.size();
+
+    return fclose(pFile) == 0 && ok;
+  }
+
+  static bool Read(const char* path, std::vector<Event>& events)
+  {
+    FILE* pFile = fopen(path, "rb");
+
+    if (!pFile)
+      return false;
+
+    uint32_t header[4];
+    bool ok = fread(header, sizeof(header), 1, pFile) == 1 && header[0] == kFileMagic && header[1] == kFileVersion && header[3] == sizeof(Event);
+
+    if (ok)
+    {
+      events.resize(header[2]);
+      ok = events.empty() || fread(events.data(), sizeof(Event), events.size(), pFile) == events.size();
+    }
+
+    fclose(pFile);
+    return ok;
+  }
+
+private:
+  struct Slot
+  {
+    std::atomic<uint64_t> mSeq {0}; // index + 1 of the event in the slot, 0 while it is being written
+    Event mEvent = {};
+  };
+
+  std::unique_ptr<Slot[]> mSlots;
+  uint64_t mSize;
+  std::atomic<uint64_t> mHead {0};
+  std::atomic<bool> mEnabled {false};
+  std::atomic<bool> mDeadlineMissed {false};
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstring>
+
+#include "IControls.h"
+
+using namespace iplug;
+using namespace igraphics;
+
+/** An ICaptionControl that keeps its rendered text in a layer. It only formats the value when the value changes, and is only marked dirty
+ *  and lays the text out again when the string it shows changes. While a parameter is automated its value changes every block, but a
+ *  display with a few digits only changes on some of them, and the rest don't redraw at all */
+class ICachedCaptionControl : public ICaptionControl
+{
+public:
+  using ICaptionControl::ICaptionControl;
+
+  /** ICaptionControl formats the string here, so this is where an unchanged value skips the formatting, and an unchanged string the redraw */
+  void SetDirty(bool triggerAction = true, int valIdx = kNoValIdx) override
+  {
+    const double value = GetValue();
+
+    if (value == mFormattedValue && !triggerAction)
+    {
+      // not a new value but something else that needs a redraw, e.g. SetDisabled() or SetText(), so the string stays and the layer is redrawn
+      IControl::SetDirty(false, valIdx);
+
+      if (mLayer)
+        mLayer->Invalidate();
+
+      return;
+    }
+
+    mFormattedValue = value;
+
+    const bool wasDirty = mDirty;
+    ICaptionControl::SetDirty(triggerAction, valIdx);
+
+    if (strcmp(GetStr(), mCachedStr.Get()) == 0)
+    {
+      mDirty = wasDirty; // the action, if any, has run, and what is shown hasn't changed
+      return;
+    }
+
+    mCachedStr.Set(GetStr());
+
+    if (mLayer)
+      mLayer->Invalidate();
+  }
+
+  void Draw(IGraphics& g) override
+  {
+    if (!g.CheckLayer(mLayer))
+    {
+      // the blend is applied when the layer is drawn, so it mustn't be applied to what's in it as well
+      const IBlend blend = mBlend;
+      mBlend = IBlend();
+      g.StartLayer(this, mRECT);
+      ICaptionControl::Draw(g);
+      mLayer = g.EndLayer();
+      mBlend = blend;
+    }
+
+    g.DrawLayer(mLayer, &mBlend);
+  }
+
+  void OnResize() override
+  {
+    ICaptionControl::OnResize();
+
+    if (mLayer)
+      mLayer->Invalidate();
+  }
+
+  void OnRescale() override
+  {
+    if (mLayer)
+      mLayer->Invalidate();
+  }
+
+private:
+  double mFormattedValue = -1.; // normalized values are never negative, so the first change always formats
+  WDL_String mCachedStr; // what the layer shows
+  ILayerPtr mLayer;
+};
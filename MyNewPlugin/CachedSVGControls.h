@@ -0,0 +1,115 @@
+#pragma once
+
+#include "IControls.h"
+
+using namespace iplug;
+using namespace igraphics;
+
+/** An ISVGSliderControl that rasterizes its track and handle once and then only blits them, so that moving the slider
+ *  doesn't re-render vector paths. The bitmaps are rebuilt when the control is resized or the screen scale changes */
+class ICachedSVGSliderControl : public ISVGSliderControl
+{
+public:
+  using ISVGSliderControl::ISVGSliderControl;
+
+  void Draw(IGraphics& g) override
+  {
+    // the handle is always the same size, so it's rasterized wherever it happens to be and drawn at its current position
+    const IRECT handleBounds = GetHandleBounds();
+
+    if (!g.CheckLayer(mTrackLayer))
+    {
+      g.StartLayer(this, mRECT);
+      g.DrawSVG(mTrackSVG, mTrackSVGBounds);
+      mTrackLayer = g.EndLayer();
+    }
+
+    if (!g.CheckLayer(mHandleLayer))
+    {
+      g.StartLayer(this, handleBounds);
+      g.DrawSVG(mHandleSVG, handleBounds);
+      mHandleLayer = g.EndLayer();
+    }
+
+    g.DrawLayer(mTrackLayer, &mBlend);
+    g.DrawBitmap(mHandleLayer->GetBitmap(), handleBounds, 0, 0, &mBlend);
+  }
+
+  void OnResize() override
+  {
+    ISVGSliderControl::OnResize();
+    InvalidateLayers();
+  }
+
+  void OnRescale() override
+  {
+    InvalidateLayers();
+  }
+
+private:
+  void InvalidateLayers()
+  {
+    if (mTrackLayer)
+      mTrackLayer->Invalidate();
+
+    if (mHandleLayer)
+      mHandleLayer->Invalidate();
+  }
+
+  ILayerPtr mTrackLayer;
+  ILayerPtr mHandleLayer;
+};
+
+/** A knob that draws an SVG rotated with its value, like ISVGKnobControl, but rasterizes the SVG once and rotates the bitmap.
+ *  The bitmap is rebuilt when the control is resized or the screen scale changes */
+class ICachedSVGKnobControl : public IKnobControlBase
+{
+public:
+  ICachedSVGKnobControl(const IRECT& bounds, const ISVG& svg, int paramIdx = kNoParameter, float startAngle = -135.f, float endAngle = 135.f)
+  : IKnobControlBase(bounds, paramIdx)
+  , mSVG(svg)
+  , mStartAngle(startAngle)
+  , mEndAngle(endAngle)
+  {
+  }
+
+  void Draw(IGraphics& g) override
+  {
+    if (!g.CheckLayer(mLayer))
+    {
+      g.StartLayer(this, mRECT);
+      g.DrawSVG(mSVG, mRECT);
+      mLayer = g.EndLayer();
+    }
+
+    g.DrawRotatedBitmap(mLayer->GetBitmap(), mRECT.MW(), mRECT.MH(), mStartAngle + GetValue() * (mEndAngle - mStartAngle), &mBlend);
+  }
+
+  void OnResize() override
+  {
+    if (mLayer)
+      mLayer->Invalidate();
+  }
+
+  void OnRescale() override
+  {
+    if (mLayer)
+      mLayer->Invalidate();
+  }
+
+  void SetSVG(const ISVG& svg)
+  {
+    mSVG = svg;
+
+    if (mLayer)
+      mLayer->Invalidate();
+
+    SetDirty(false);
+  }
+
+private:
+  ISVG mSVG;
+  float mStartAngle;
+  float mEndAngle;
+  ILayerPtr mLayer;
+};
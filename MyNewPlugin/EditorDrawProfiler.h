@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#if !defined _MSC_VER
+#include <cxxabi.h>
+#include <cstdlib>
+#endif
+
+#include "IControl.h"
+
+using namespace iplug;
+using namespace igraphics;
+
+/** Measures what each control in the editor costs to draw, so that UI regressions can be caught like DSP ones.
+ *  Attach it after every other control, covering the whole editor. While it runs, every frame it moves the value of each control
+ *  that has a parameter along its own sine wave, then draws every other control into an offscreen layer and times each Draw() call.
+ *  The values are only set on the controls, so the host and the DSP never see the animation.
+ *  After the frames for one scale it moves on to the next, and at the end reports the mean and worst time per control for each scale,
+ *  most expensive first, and puts the editor back to the scale it had. Scales are changed by OnDisplayTick(), which must be called from the
+ *  editor's display tick function, so that the editor isn't resized while IGraphics is going through its controls.
+ *  Controls are named by their class and parameter, or by SetControlName().
+ *  With a CPU rasterizer (e.g. IGRAPHICS_SKIA with IGRAPHICS_CPU) the times are the full cost of rasterizing. With a GPU backend they
+ *  are the cost of building the draw commands */
+class IDrawProfilerControl : public IControl
+{
+public:
+  /** Called with the report once every scale has been profiled */
+  using ReportFunc = std::function<void(const std::string& report)>;
+
+  IDrawProfilerControl(const IRECT& bounds, int nFrames, const std::vector<float>& scales, ReportFunc reportFunc)
+  : IControl(bounds)
+  , mNFrames(std::max(nFrames, 1))
+  , mScales(scales)
+  , mReportFunc(reportFunc)
+  {
+    SetIgnoreMouse(true);
+
+    if (mScales.empty())
+      mScales.push_back(1.f);
+  }
+
+  /** Name a control in the report, instead of by its class and parameter */
+  void SetControlName(const IControl* pControl, const char* name)
+  {
+    mNames.emplace_back(pControl, name);
+  }
+
+  /** Switches to the next scale to profile, and back when done. Call from the editor's display tick function */
+  void OnDisplayTick()
+  {
+    IGraphics* pGraphics = GetUI();
+
+    if (mScaleIdx >= (int) mScales.size())
+    {
+      if (mInitialScale > 0.f) // put the editor back the way it was
+      {
+        pGraphics->Resize(pGraphics->Width(), pGraphics->Height(), mInitialScale);
+        mInitialScale = 0.f;
+      }
+
+      return;
+    }
+
+    if (mInitialScale < 0.f)
+      mInitialScale = pGraphics->GetDrawScale();
+
+    if (mFrame == 0 && pGraphics->GetDrawScale() != mScales[mScaleIdx])
+      pGraphics->Resize(pGraphics->Width(), pGraphics->Height(), mScales[mScaleIdx]); // redraws everything, and Draw() waits for the scale
+  }
+
+  void Animate() override
+  {
+    if (mScaleIdx < (int) mScales.size())
+      SetDirty(false);
+  }
+
+  void Draw(IGraphics& g) override
+  {
+    if (mScaleIdx >= (int) mScales.size() || g.GetDrawScale() != mScales[mScaleIdx])
+      return;
+
+    const int nControls = g.NControls();
+
+    if (mTimes.empty())
+      mTimes.assign(mScales.size() * nControls, Timing());
+
+    const double phase = 2. * 3.14159265358979 * mFrame / 60.; // one cycle a second at 60 fps
+
+    for (int i = 0; i < nControls; i++)
+    {
+      IControl* pControl = g.GetControl(i);
+
+      if (pControl != this && pControl->GetParamIdx() > kNoParameter)
+        pControl->SetValue(0.5 + 0.5 * std::sin(phase + i));
+    }
+
+    g.StartLayer(this, mRECT);
+
+    for (int i = 0; i < nControls; i++)
+    {
+      IControl* pControl = g.GetControl(i);
+
+      if (pControl == this || pControl->IsHidden())
+        continue;
+
+      const auto start = std::chrono::steady_clock::now();
+      pControl->Draw(g);
+      const double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+      Timing& timing = mTimes[mScaleIdx * nControls + i];
+      timing.mTotal += micros;
+      timing.mMax = std::max(timing.mMax, micros);
+    }
+
+    g.EndLayer(); // thrown away, nothing the profiler draws should reach the screen
+
+    if (++mFrame == mNFrames)
+    {
+      mFrame = 0;
+
+      if (++mScaleIdx == (int) mScales.size())
+      {
+        if (mReportFunc)
+          mReportFunc(MakeReport(g));
+
+        // leave the values where the parameters are
+        for (int i = 0; i < nControls; i++)
+        {
+          if (g.GetControl(i)->GetParamIdx() > kNoParameter)
+            g.GetControl(i)->SetValueFromDelegate(g.GetControl(i)->GetParam()->GetNormalized());
+        }
+      }
+    }
+  }
+
+private:
+  struct Timing
+  {
+    double mTotal = 0.;
+    double mMax = 0.;
+  };
+
+  std::string GetControlName(const IControl* pControl) const
+  {
+    for (const auto& name : mNames)
+    {
+      if (name.first == pControl)
+        return name.second;
+    }
+
+    const char* typeName = typeid(*pControl).name();
+    std::string name = typeName;
+#if defined _MSC_VER
+    if (name.compare(0, 6, "class ") == 0)
+      name.erase(0, 6);
+#else
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(typeName, nullptr, nullptr, &status);
+
+    if (status == 0 && demangled)
+      name = demangled;
+
+    free(demangled);
+#endif
+    if (name.compare(0, 18, "iplug::igraphics::") == 0)
+      name.erase(0, 18);
+
+    if (pControl->GetParam())
+      name = name + " (" + pControl->GetParam()->GetName() + ")";
+
+    return name;
+  }
+
+  std::string MakeReport(IGraphics& g) const
+  {
+    const int nControls = g.NControls();
+    std::string report;
+    char line[256];
+
+    for (int s = 0; s < (int) mScales.size(); s++)
+    {
+      std::vector<int> order;
+      double frameTotal = 0.;
+
+      for (int i = 0; i < nControls; i++)
+      {
+        if (g.GetControl(i) != this)
+        {
+          order.push_back(i);
+          frameTotal += mTimes[s * nControls + i].mTotal;
+        }
+      }
+
+      std::sort(order.begin(), order.end(), [&](int a, int b) { return mTimes[s * nControls + a].mTotal > mTimes[s * nControls + b].mTotal; });
+
+      snprintf(line, sizeof(line), "scale %gx, %d frames, %.1f us per frame drawing every control\n", mScales[s], mNFrames, frameTotal / mNFrames);
+      report += line;
+
+      for (int i : order)
+      {
+        const Timing& timing = mTimes[s * nControls + i];
+        const IRECT& r = g.GetControl(i)->GetRECT();
+        snprintf(line, sizeof(line), "  %3d %-40.40s %8.1f us mean %8.1f us max   [%.0f %.0f %.0f %.0f]\n", i, GetControlName(g.GetControl(i)).c_str(),
+                 timing.mTotal / mNFrames, timing.mMax, r.L, r.T, r.R, r.B);
+        report += line;
+      }
+    }
+
+    return report;
+  }
+
+  int mNFrames;
+  std::vector<float> mScales;
+  ReportFunc mReportFunc;
+  int mScaleIdx = 0;
+  int mFrame = 0;
+  float mInitialScale = -1.f;
+  std::vector<Timing> mTimes; // [scale][control]
+  std::vector<std::pair<const IControl*, std::string>> mNames;
+};
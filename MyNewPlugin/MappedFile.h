@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+/** A read-only memory mapping of a whole file. Pages are only read from disk when they are first touched, so mapping a large file is cheap */
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  ~MappedFile() { Unmap(); }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  /** Map a file, replacing any file that was mapped
+   * @param path UTF-8 path to the file
+   * @return \c false if the file couldn't be opened or is empty */
+#ifdef _WIN32
+  bool Map(const char* path)
+  {
+    Unmap();
+
+    wchar_t widePath[MAX_PATH];
+
+    if (!MultiByteToWideChar(CP_UTF8, 0, path, -1, widePath, MAX_PATH))
+      return false;
+
+    mFile = CreateFileW(widePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (mFile == INVALID_HANDLE_VALUE)
+      return false;
+
+    LARGE_INTEGER size;
+
+    if (!GetFileSizeEx(mFile, &size) || size.QuadPart == 0)
+    {
+      Unmap();
+      return false;
+    }
+
+    mMapping = CreateFileMappingW(mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    mData = mMapping ? static_cast<const uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+
+    if (!mData)
+    {
+      Unmap();
+      return false;
+    }
+
+    mSize = (size_t) size.QuadPart;
+    return true;
+  }
+
+  void Unmap()
+  {
+    if (mData)
+      UnmapViewOfFile(mData);
+
+    if (mMapping)
+      CloseHandle(mMapping);
+
+    if (mFile != INVALID_HANDLE_VALUE)
+      CloseHandle(mFile);
+
+    mData = nullptr;
+    mMapping = NULL;
+    mFile = INVALID_HANDLE_VALUE;
+    mSize = 0;
+  }
+#else
+  bool Map(const char* path)
+  {
+    Unmap();
+
+    const int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+      return false;
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+      close(fd);
+      return false;
+    }
+
+    void* pMapping = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps its own reference to the file
+
+    if (pMapping == MAP_FAILED)
+      return false;
+
+    mData = static_cast<const uint8_t*>(pMapping);
+    mSize = (size_t) st.st_size;
+    return true;
+  }
+
+  void Unmap()
+  {
+    if (mData)
+      munmap(const_cast<uint8_t*>(mData), mSize);
+
+    mData = nullptr;
+    mSize = 0;
+  }
+#endif
+
+  const uint8_t* GetData() const { return mData; }
+
+  size_t GetSize() const { return mSize; }
+
+private:
+#ifdef _WIN32
+  HANDLE mFile = INVALID_HANDLE_VALUE;
+  HANDLE mMapping = NULL;
+#endif
+  const uint8_t* mData = nullptr;
+  size_t mSize = 0;
+};
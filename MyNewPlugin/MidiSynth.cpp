@@ -26,7 +26,7 @@ MidiSynth::MidiSynth(EPolyMode polyMode, int blockSize, int nUnisonVoices)
 
 MidiSynth::~MidiSynth()
 {
-  mVS.Empty(true);
+  ClearVoices();
 }
 
 bool MidiSynth::ProcessBlock(sample** inputs, sample** outputs, int nInputs, int nOutputs, int nFrames)
@@ -47,6 +47,9 @@ bool MidiSynth::ProcessBlock(sample** inputs, sample** outputs, int nInputs, int
 
     while(samplesRemaining > 0)
     {
+      if(mDeterministic) // slices are aligned to absolute time, so the first one in a block may be partial
+        bs = mGranularity - static_cast<int>(mSampleTime % mGranularity);
+
       if(samplesRemaining < bs)
         bs = samplesRemaining;
 
@@ -57,8 +60,11 @@ bool MidiSynth::ProcessBlock(sample** inputs, sample** outputs, int nInputs, int
       while (!mMidiQueue.Empty())
       {
         IMidiMsg& msg = mMidiQueue.Peek();
+        // every message is handled at the start of the slice it falls in. Quantized ones are already on slice starts,
+        // and sample accurate notes pass on where in the slice they fall
+        if (msg.mOffset >= s + bs) break;
 
-        if (msg.mOffset > s) break;
+        mNoteOffset = (mSampleAccurateNotes && IsNoteOnOrOff(msg)) ? std::max(msg.mOffset - s, 0) : 0;
 
         int status = msg.StatusMsg(); // get the MIDI status byte
 
@@ -186,9 +192,12 @@ bool MidiSynth::ProcessBlock(sample** inputs, sample** outputs, int nInputs, int
     mVoicesAreActive = voicesbusy;
 
     mMidiQueue.Flush(nFrames);
+    mLastQueuedOffset = std::max(mLastQueuedOffset - nFrames, 0);
   }
   else // empty block
   {
+    mSampleTime += nFrames; // keep counting, so that slice alignment doesn't depend on when the synth was idle
+    mLastQueuedOffset = 0;
     return true;
   }
 
@@ -338,18 +347,23 @@ inline void MidiSynth::TriggerPolyNote(KeyPressInfo keyPress)
   {
     int v = -1;
 
-    v = FindFreeVoice(); // or first one triggered
+    if (mReuseVoicesForSameKey)
+      v = FindVoiceForKey(keyPress.mKey, uv);
+
+    if (v == -1)
+      v = FindFreeVoice(); // or first one triggered
   
     if (v == -1) // shouldn't happen
       return;
   
     Voice* pVoice = GetVoice(v);
     
-    pVoice->mStartTime = mSampleTime;
+    pVoice->mStartTime = mSampleTime + mNoteOffset;
     pVoice->mKey = keyPress.mKey;
     pVoice->mStackIdx = uv;
     pVoice->mBasePitch = GetAdjustedPitch(keyPress.mKey);
     pVoice->mAftertouch = 0.;
+    pVoice->mTriggerOffset = mNoteOffset;
     pVoice->Trigger(keyPress.mVelNorm, pVoice->GetBusy()); // if voice is busy it will retrigger
   }
   
@@ -368,6 +382,7 @@ void MidiSynth::TriggerMonoNote(KeyPressInfo note)
     pVoice->mStackIdx = v;
     pVoice->mBasePitch = GetAdjustedPitch(note.mKey);
     pVoice->mAftertouch = 0.;
+    pVoice->mTriggerOffset = mNoteOffset;
 
     const bool voiceFree = !pVoice->GetBusy();
     const bool voiceReleased = pVoice->GetReleased();
@@ -387,10 +402,12 @@ void MidiSynth::TriggerMonoNote(KeyPressInfo note)
 
 void MidiSynth::SetSampleRateAndBlockSize(double sampleRate, int blockSize)
 {
-  Reset();
-
+  // hosts call this on transport starts and buffer size changes, so voices and held keys are left alone. Call Reset() to stop everything
   mSampleRate = sampleRate;
-  mMidiQueue.Resize(blockSize);
+
+  // only ever grows, so that a smaller block size after a larger one doesn't reallocate, and anything already queued is kept
+  if (blockSize > mMidiQueueSize)
+    mMidiQueueSize = mMidiQueue.Resize(blockSize);
 
   for(int v = 0; v < NVoices(); v++)
   {
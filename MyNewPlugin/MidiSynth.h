@@ -15,6 +15,7 @@
  * @copydoc MIDISynth
  */
 
+#include <algorithm>
 #include <vector>
 #include <bitset>
 #include <stdint.h>
@@ -128,6 +129,8 @@ public:
     double mBasePitch = 0.;
     double mAftertouch = 0.;
     int mStackIdx = -1;
+    int mTriggerOffset = 0; // frames into the next ProcessSamples() call at which the note from the last Trigger() starts, see SetSampleAccurateNotes()
+    int mReleaseOffset = 0; // likewise for the last Release()
 
     friend class MidiSynth;
   };
@@ -140,17 +143,49 @@ public:
   void Reset()
   {
     mSampleTime = 0;
+    mLastQueuedOffset = 0;
+    mMidiQueue.Clear();
     mHeldKeys.clear();
     mSustainedNotes.clear();
     KillAllVoices(false);
   }
 
+  /** Update the sample rate and make room for a block size's worth of MIDI. Voices keep playing, their SetSampleRate() updates anything that depends on the rate
+   * @param sampleRate The new sample rate
+   * @param blockSize The largest block size the host will use */
   virtual void SetSampleRateAndBlockSize(double sampleRate, int blockSize);
   
   void SetGranularity(int granularity)
   {
     mGranularity = granularity;
   }
+
+  /** In deterministic mode the output depends only on the MIDI and its absolute timing, not on how the host splits it into blocks:
+   * processing slices are aligned to multiples of the granularity in absolute sample time, and each MIDI message takes effect at the first slice
+   * boundary at or after it, rather than at the start of the slice it falls in
+   * @param deterministic \c true to enable, off by default so that live MIDI is handled as early as possible */
+  void SetDeterministic(bool deterministic)
+  {
+    mDeterministic = deterministic;
+  }
+
+  /** When a key is struck again while a voice is still playing or releasing it, retrigger that voice rather than taking another one,
+   * so that repeated notes on a key use a bounded number of voices. How the voice restarts is up to its Trigger() with isRetrigger set
+   * @param reuse \c true to reuse voices, off by default */
+  void SetReuseVoicesForSameKey(bool reuse)
+  {
+    mReuseVoicesForSameKey = reuse;
+  }
+
+  /** Normally a note-on or note-off takes effect at the start of the slice it falls in, so it can be up to mGranularity - 1 samples early or late.
+   * With sample accurate notes the voice is triggered or released in that slice with its mTriggerOffset or mReleaseOffset set to where in the slice
+   * the message falls, and a voice that supports it starts or releases the note there, so slices can stay coarse without smearing note timing.
+   * Voices that ignore the offsets behave as before. Other messages are still handled at slice boundaries
+   * @param sampleAccurate \c true to enable, off by default */
+  void SetSampleAccurateNotes(bool sampleAccurate)
+  {
+    mSampleAccurateNotes = sampleAccurate;
+  }
   
   /** If you are using this class in a non-traditional mode of polyphony (e.g.to stack loads of voices) you might want to manually SetVoicesActive()
    * usually this would happen when you trigger notes
@@ -179,6 +214,11 @@ public:
   {
     mPitchOffset = offset;
   }
+
+  double GetNoteOffset() const
+  {
+    return mPitchOffset;
+  }
   
   inline Voice* GetVoice(int voiceIdx) const
   {
@@ -227,14 +267,19 @@ public:
     return mPolyMode;
   }
 
-  void AddVoice(Voice* pVoice)
+  /** @param takeOwnership \c false if the caller deletes the voice after the synth, e.g. because it allocated all its voices in one block */
+  void AddVoice(Voice* pVoice, bool takeOwnership = true)
   {
     mVS.Add(pVoice);
+
+    if (takeOwnership)
+      mOwnedVoices.Add(pVoice);
   }
   
   void ClearVoices()
   {
-    mVS.Empty(true);
+    mVS.Empty(false);
+    mOwnedVoices.Empty(true);
   }
 
   void AddMidiMsgToQueue(const IMidiMsg& msg)
@@ -242,7 +287,24 @@ public:
     IMidiMsg quantizedMsg = msg;
 
     if(mGranularity > 1)
-      quantizedMsg.mOffset = (msg.mOffset / mGranularity) * mGranularity;
+    {
+      if(mSampleAccurateNotes && IsNoteOnOrOff(msg))
+      {
+        // keeps its exact offset, see ProcessBlock()
+      }
+      else if(mDeterministic) // round up to a slice boundary in absolute time, which is the same whatever the block size
+      {
+        const int64_t time = mSampleTime + msg.mOffset;
+        quantizedMsg.mOffset = static_cast<int>((time + mGranularity - 1) / mGranularity * mGranularity - mSampleTime);
+      }
+      else
+        quantizedMsg.mOffset = (msg.mOffset / mGranularity) * mGranularity;
+
+      // never move a message ahead of one that came before it, e.g. a note-off ahead of its note-on in the same slice,
+      // or a note-off ahead of a sustain pedal press that has been rounded up to the next slice
+      quantizedMsg.mOffset = std::max(quantizedMsg.mOffset, mLastQueuedOffset);
+      mLastQueuedOffset = quantizedMsg.mOffset;
+    }
 
     mMidiQueue.Add(quantizedMsg);
   }
@@ -292,6 +354,11 @@ protected:
     return key + mPitchOffset;
   }
 
+  static bool IsNoteOnOrOff(const IMidiMsg& msg)
+  {
+    return msg.StatusMsg() == IMidiMsg::kNoteOn || msg.StatusMsg() == IMidiMsg::kNoteOff;
+  }
+
   void NoteOnOffMono(const IMidiMsg& msg);
 
   void NoteOnOffPoly(const IMidiMsg& msg);
@@ -316,6 +383,7 @@ protected:
 
   inline void StopVoice(Voice& voice)
   {
+    voice.mReleaseOffset = mNoteOffset;
     voice.Release();
     voice.RemovedFromKey();
   }
@@ -327,6 +395,7 @@ protected:
       if (GetVoice(v)->GetBusy())
       {
         Voice* pVoice = GetVoice(v);
+        pVoice->mReleaseOffset = 0;
         pVoice->Release();
         pVoice->RemovedFromKey();
       }
@@ -365,6 +434,20 @@ protected:
     return false;
   }
 
+  /** @return A busy voice that is playing, or releasing, key at the given unison stack index, or -1 if there isn't one */
+  inline int FindVoiceForKey(int key, int stackIdx)
+  {
+    for(int v = 0; v < NVoices(); v++)
+    {
+      Voice* pVoice = GetVoice(v);
+
+      if(pVoice->GetBusy() && pVoice->mStackIdx == stackIdx && (pVoice->mKey == key || (pVoice->mKey == -1 && pVoice->mPrevKey == key)))
+        return v;
+    }
+
+    return -1;
+  }
+
   inline int FindFreeVoice()
   {
     for(int v = 0; v < NVoices(); v++)
@@ -392,6 +475,7 @@ protected:
   {
     return mMidiQueue.Empty();
   }
+
   
 public:
   const std::vector<KeyPressInfo>& GetHeldKeys() { return mHeldKeys; }
@@ -399,6 +483,7 @@ public:
 private:
   int mNVoices = MAX_VOICES;
   WDL_PtrList<Voice> mVS;
+  WDL_PtrList<Voice> mOwnedVoices; // the ones in mVS the synth deletes
   int mGranularity = 16;
 
   int mPrevKey = -1;
@@ -410,6 +495,11 @@ private:
   double mPitchOffset = 0.; // Adjustment in semitones of notes
   bool mSustainPedalDown = false;
   bool mVoicesAreActive = false;
+  bool mDeterministic = false;
+  bool mReuseVoicesForSameKey = false;
+  bool mSampleAccurateNotes = false;
+  int mNoteOffset = 0; // where in the current slice the note-on or note-off being handled falls
+  int mLastQueuedOffset = 0; // offset of the last message added to the queue, see AddMidiMsgToQueue()
   uint16_t mUnisonVoices = 1;
   std::bitset<MAX_VOICES> mVoiceStatus;
   EPolyMode mPolyMode = kPolyModePoly; // mono note priority / polyphony
@@ -418,6 +508,7 @@ private:
   std::vector<KeyPressInfo> mSustainedNotes; // Any notes that are sustained, including those that are physically held
   std::vector<int> mReleasedVoicesPlayingKey; // Used to retrigger released voices that were linked to key
   IMidiQueue mMidiQueue;
+  int mMidiQueueSize = 0;
 
 public: // these are public for state saving
   int mVelocityLUT[128];
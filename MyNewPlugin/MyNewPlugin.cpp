@@ -3,23 +3,119 @@
 
 #if IPLUG_EDITOR
 #include "IControls.h"
+#include "CachedCaptionControl.h"
+#include "CachedSVGControls.h"
+#if PLUG_PROFILE_EDITOR_FRAMES > 0
+#include "EditorDrawProfiler.h"
+#endif
+
+#if PLUG_CACHE_SVG_CONTROLS
+using SVGSliderControl = ICachedSVGSliderControl;
+using SVGKnobControl = ICachedSVGKnobControl;
+#else // iPlug2's own, which render the SVGs on every redraw
+using SVGSliderControl = ISVGSliderControl;
+using SVGKnobControl = ISVGKnobControl;
+#endif
+#endif
+
+#if IPLUG_DSP && defined WAM_API
+#include <emscripten.h>
+#endif
+
+#if IPLUG_DSP || (IPLUG_EDITOR && PLUG_PROFILE_EDITOR_FRAMES > 0)
+static const char* GetTempDir()
+{
+  const char* pTempDir = getenv("TMPDIR");
+
+  if (!pTempDir)
+    pTempDir = getenv("TEMP");
+
+  if (!pTempDir)
+    pTempDir = "/tmp";
+
+  return pTempDir;
+}
+#endif
+
+#if IPLUG_EDITOR && PLUG_PROFILE_EDITOR_FRAMES > 0
+/** Prints the editor draw profile, and writes it to a file in the temp folder, so that a release build of the standalone app can be profiled */
+static void WriteDrawProfile(const std::string& report)
+{
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/%s-draw-profile.txt", GetTempDir(), PLUG_NAME);
+
+  fputs(report.c_str(), stdout);
+  fflush(stdout);
+
+  if (FILE* pFile = fopen(path, "w"))
+  {
+    fputs(report.c_str(), pFile);
+    fclose(pFile);
+    printf("Editor draw profile written to %s\n", path);
+  }
+}
+#endif
+
+#if IPLUG_DSP
+static constexpr double kBlackBoxSeconds = 10.; // how much of the recording is dumped
+static constexpr double kBlackBoxDumpIntervalSeconds = 30.;
+static constexpr int kMaxBlackBoxDumps = 4; // dumps take turns with this many file names, so a long session can't fill the disk
+
+static MySynthVoiceSettings MakeVoiceSettings(const double* values)
+{
+  MySynthVoiceSettings settings;
+  settings.mAttackMs = values[kParamAmpAttack];
+  settings.mDecayMs = values[kParamAmpDecay];
+  settings.mSustainLevel = values[kParamAmpSustain] / 100.;
+  settings.mReleaseMs = values[kParamAmpRelease];
+  return settings;
+}
+
+static MySynthVoice::ERetriggerMode MakeRetriggerMode(const double* values)
+{
+  return MySynthVoice::RetriggerModeFromValue(values[kParamRetrigger]);
+}
+
+static void PreparePresetSnapshot(const double* values, int nValues, PresetSnapshot& snapshot)
+{
+  std::copy(values, values + nValues, snapshot.mValues);
+  snapshot.mVoiceSettings = MakeVoiceSettings(values);
+}
+
+static void PrepareMorphEndpoints(const double* values, int nValues, MorphEndpoints& endpoints)
+{
+  std::copy(values, values + kNumParams, endpoints.mA);
+  std::copy(values + kNumParams, values + 2 * kNumParams, endpoints.mB);
+  endpoints.mActive = values[2 * kNumParams] != 0.;
+}
 #endif
 
 MyNewPlugin::MyNewPlugin(const InstanceInfo& info)
 : Plugin(info, MakeConfig(kNumParams, kNumPresets))
+#if IPLUG_DSP
+, mEngine(kNumVoices)
+, mPresetEngine(kNumParams, PreparePresetSnapshot)
+, mMorphEngine(2 * kNumParams + 1, PrepareMorphEndpoints)
+#endif
 {
   GetParam(kParamGain)->InitDouble("Gain", 0., 0., 100.0, 0.01, "%"); // TASK_04
   GetParam(kParamAmpAttack)->InitDouble("Attack", 10., 1., 1000., 0.1, "ms", IParam::kFlagsNone, "ADSR", IParam::ShapePowCurve(3.));
   GetParam(kParamAmpDecay)->InitDouble("Decay", 10., 1., 1000., 0.1, "ms", IParam::kFlagsNone, "ADSR", IParam::ShapePowCurve(3.));
   GetParam(kParamAmpSustain)->InitDouble("Sustain", 50., 0., 100., 1, "%", IParam::kFlagsNone, "ADSR");
   GetParam(kParamAmpRelease)->InitDouble("Release", 10., 2., 1000., 0.1, "ms", IParam::kFlagsNone, "ADSR");
+  GetParam(kParamMorph)->InitDouble("Morph", 0., 0., 100., 0.1, "%");
+  GetParam(kParamRetrigger)->InitEnum("Retrigger", MySynthVoice::kRetriggerLegato, MySynthVoice::kNumRetriggerModes, "", IParam::kFlagsNone, "", "Legato", "Reset", "Free");
 
-#if IPLUG_DSP
-  for (int i = 0; i < kNumVoices; i++) {
-    auto* newVoice = new MySynthVoice();
-    mVoices.push_back(newVoice);
-    mSynth.AddVoice(newVoice); // takes ownership
+  // see kFactoryPresets in PluginState.h
+  for (const FactoryPreset& preset : kFactoryPresets)
+  {
+    IByteChunk chunk;
+    MakeFactoryPresetChunk(preset, chunk);
+    MakePresetFromChunk(preset.mName, chunk);
   }
+
+#if IPLUG_DSP && PLUG_BLACKBOX_RECORDING
+  mEngine.mRecorder.SetEnabled(true);
 #endif
   
 #if IPLUG_EDITOR // http://bit.ly/2S64BDd
@@ -29,88 +125,435 @@ MyNewPlugin::MyNewPlugin(const InstanceInfo& info)
   
   mLayoutFunc = [&](IGraphics* pGraphics) {
     
+    const EditorLayout layout(pGraphics->GetBounds());
+
+    if (pGraphics->NControls()) // the editor was resized: controls and their caches stay, only the bounds that changed are updated
+    {
+      pGraphics->GetBackgroundControl()->SetTargetAndDrawRECTs(layout.mBounds);
+
+      for (auto& placement : mPlacements)
+      {
+        const IRECT bounds = placement.second(layout);
+
+        if (bounds != placement.first->GetRECT())
+          placement.first->SetTargetAndDrawRECTs(bounds);
+      }
+
+      return;
+    }
+
+    mPlacements.clear();
+
     /* SETUP */
     
-    pGraphics->AttachCornerResizer(EUIResizerMode::Scale, false);
+    // dragging the corner changes the editor's size, and the layout function runs again to move the controls (see above)
+    pGraphics->AttachCornerResizer(EUIResizerMode::Size, true);
+    pGraphics->SetSizeConstraints(PLUG_WIDTH * 2 / 3, PLUG_WIDTH * 2, PLUG_HEIGHT * 2 / 3, PLUG_HEIGHT * 2);
     pGraphics->AttachTextEntryControl();
     
     /* RESOURCE LOADING */
     
-    pGraphics->LoadFont("Roboto-Regular", ROBOTO_FN);
-    pGraphics->LoadFont("Logo", LOGO_FONT_FN);
-//    auto knobSVG = pGraphics->LoadSVG(BEFACO_TINYKNOB_FN); /* TASK_02 */
-    auto sliderPotSVG = pGraphics->LoadSVG(BEFACO_SLIDEPOT_FN);
-    auto sliderHandleSVG = pGraphics->LoadSVG(BEFACO_SLIDEPOTHANDLE_FN);
-
-    /* DIVIDE UP BOUNDS FOR LAYOUT */
-
-    const IRECT bounds = pGraphics->GetBounds();
-    const IRECT keyboardArea = bounds.GetFromBottom(100);
-    const IRECT controlsArea = bounds.GetReducedFromBottom(100).GetPadded(-10);
-    const IRECT column1 = controlsArea.GetGridCell(0, 1, 3).GetPadded(-10);
-    const IRECT column2 = controlsArea.GetGridCell(1, 1, 3).GetPadded(-10);
-    const IRECT column3 = controlsArea.GetGridCell(2, 1, 3).GetPadded(-10);
-    const IRECT masterArea = column3.FracRectVertical(0.75, true);
-    const IRECT logoArea = column3.FracRectVertical(0.25, false);
-    const IRECT ampEG = column2.FracRectVertical(0.5, true);
-    const IRECT ampEGLabelsArea = ampEG.GetGridCell(0, 3, 1);
-    const IRECT ampEGSlidersArea = ampEG.GetGridCell(1, 3, 1);
-    const IRECT ampEGValuesArea = ampEG.GetGridCell(2, 3, 1);
-    
+    LoadFont(pGraphics, "Roboto-Regular", ROBOTO_FN);
+    LoadFont(pGraphics, "Logo", LOGO_FONT_FN);
+//    auto knobSVG = LoadSVG(pGraphics, BEFACO_TINYKNOB_FN); /* TASK_02 */
+    auto sliderPotSVG = LoadSVG(pGraphics, BEFACO_SLIDEPOT_FN);
+    auto sliderHandleSVG = LoadSVG(pGraphics, BEFACO_SLIDEPOTHANDLE_FN);
+
     /* ADD CONTROLS */
+
+    // Each control is placed by a rule that picks its bounds out of the layout (see EditorLayout), so that a resize can move it without rebuilding it
     
     // Background control, either a fixed color, gradient, svg or bitmap
     pGraphics->AttachPanelBackground(COLOR_LIGHT_GRAY); /* TASK_01 */
-//    pGraphics->AttachPanelBackground(IPattern::CreateLinearGradient(bounds, EDirection::Vertical, {{COLOR_LIGHT_GRAY, 0.}, {COLOR_DARK_GRAY, 1.}}));
+//    pGraphics->AttachPanelBackground(IPattern::CreateLinearGradient(layout.mBounds, EDirection::Vertical, {{COLOR_LIGHT_GRAY, 0.}, {COLOR_DARK_GRAY, 1.}}));
      
     // Group controls (background labels)
-    pGraphics->AttachControl(new IVGroupControl(controlsArea, " ", 0.f));
-    pGraphics->AttachControl(new IVGroupControl(column1.GetPadded(0, 0., 5., 0.), "OSCILLATORS"));
-    pGraphics->AttachControl(new IVGroupControl(column2.GetPadded(5., 0., 5., 0.), "ENVELOPES"));
-    pGraphics->AttachControl(new IVGroupControl(masterArea.GetPadded(5., 0., 0., 0.), "MASTER"));
+    PlaceControl(pGraphics, layout, new IVGroupControl(IRECT(), " ", 0.f), [](const EditorLayout& l) { return l.mControlsArea; });
+    PlaceControl(pGraphics, layout, new IVGroupControl(IRECT(), "OSCILLATORS"), [](const EditorLayout& l) { return l.mColumn1.GetPadded(0, 0., 5., 0.); });
+    PlaceControl(pGraphics, layout, new IVGroupControl(IRECT(), "ENVELOPES"), [](const EditorLayout& l) { return l.mColumn2.GetPadded(5., 0., 5., 0.); });
+    PlaceControl(pGraphics, layout, new IVGroupControl(IRECT(), "MASTER"), [](const EditorLayout& l) { return l.mMasterArea.GetPadded(5., 0., 0., 0.); });
     WDL_String versionStr, buildDateStr;
     GetPluginVersionStr(versionStr);
     buildDateStr.SetFormatted(100, "%s %s %s, built on %s at %.5s ", versionStr.Get(), GetArchStr(), GetAPIStr(), __DATE__, __TIME__);
-    pGraphics->AttachControl(new ITextControl(bounds.GetFromTRHC(300, 20), buildDateStr.Get()));
+    PlaceControl(pGraphics, layout, new ITextControl(IRECT(), buildDateStr.Get()), [](const EditorLayout& l) { return l.mBounds.GetFromTRHC(300, 20); });
 
     // Oscillator controls
     
     // Envelope controls
-    pGraphics->AttachControl(new ITextControl(ampEGLabelsArea.GetGridCell(0, 1, 4).GetFromBottom(20.f), "Attack"));
-    pGraphics->AttachControl(new ITextControl(ampEGLabelsArea.GetGridCell(1, 1, 4).GetFromBottom(20.f), "Decay"));
-    pGraphics->AttachControl(new ITextControl(ampEGLabelsArea.GetGridCell(2, 1, 4).GetFromBottom(20.f), "Sustain"));
-    pGraphics->AttachControl(new ITextControl(ampEGLabelsArea.GetGridCell(3, 1, 4).GetFromBottom(20.f), "Release"));
+    PlaceControl(pGraphics, layout, new ITextControl(IRECT(), "Attack"), [](const EditorLayout& l) { return l.mAmpEGLabelsArea.GetGridCell(0, 1, 4).GetFromBottom(20.f); });
+    PlaceControl(pGraphics, layout, new ITextControl(IRECT(), "Decay"), [](const EditorLayout& l) { return l.mAmpEGLabelsArea.GetGridCell(1, 1, 4).GetFromBottom(20.f); });
+    PlaceControl(pGraphics, layout, new ITextControl(IRECT(), "Sustain"), [](const EditorLayout& l) { return l.mAmpEGLabelsArea.GetGridCell(2, 1, 4).GetFromBottom(20.f); });
+    PlaceControl(pGraphics, layout, new ITextControl(IRECT(), "Release"), [](const EditorLayout& l) { return l.mAmpEGLabelsArea.GetGridCell(3, 1, 4).GetFromBottom(20.f); });
     
-    pGraphics->AttachControl(new ISVGSliderControl(ampEGSlidersArea.GetGridCell(0, 1, 4), sliderHandleSVG, sliderPotSVG, kParamAmpAttack));
-    pGraphics->AttachControl(new ISVGSliderControl(ampEGSlidersArea.GetGridCell(1, 1, 4), sliderHandleSVG, sliderPotSVG, kParamAmpDecay));
-    pGraphics->AttachControl(new ISVGSliderControl(ampEGSlidersArea.GetGridCell(2, 1, 4), sliderHandleSVG, sliderPotSVG, kParamAmpSustain));
-    pGraphics->AttachControl(new ISVGSliderControl(ampEGSlidersArea.GetGridCell(3, 1, 4), sliderHandleSVG, sliderPotSVG, kParamAmpRelease));
+    PlaceControl(pGraphics, layout, new SVGSliderControl(IRECT(), sliderHandleSVG, sliderPotSVG, kParamAmpAttack), [](const EditorLayout& l) { return l.mAmpEGSlidersArea.GetGridCell(0, 1, 4); });
+    PlaceControl(pGraphics, layout, new SVGSliderControl(IRECT(), sliderHandleSVG, sliderPotSVG, kParamAmpDecay), [](const EditorLayout& l) { return l.mAmpEGSlidersArea.GetGridCell(1, 1, 4); });
+    PlaceControl(pGraphics, layout, new SVGSliderControl(IRECT(), sliderHandleSVG, sliderPotSVG, kParamAmpSustain), [](const EditorLayout& l) { return l.mAmpEGSlidersArea.GetGridCell(2, 1, 4); });
+    PlaceControl(pGraphics, layout, new SVGSliderControl(IRECT(), sliderHandleSVG, sliderPotSVG, kParamAmpRelease), [](const EditorLayout& l) { return l.mAmpEGSlidersArea.GetGridCell(3, 1, 4); });
     
-    pGraphics->AttachControl(new ICaptionControl(ampEGValuesArea.GetGridCell(0, 1, 4).GetFromTop(20.f), kParamAmpAttack));
-    pGraphics->AttachControl(new ICaptionControl(ampEGValuesArea.GetGridCell(1, 1, 4).GetFromTop(20.f), kParamAmpDecay));
-    pGraphics->AttachControl(new ICaptionControl(ampEGValuesArea.GetGridCell(2, 1, 4).GetFromTop(20.f), kParamAmpSustain));
-    pGraphics->AttachControl(new ICaptionControl(ampEGValuesArea.GetGridCell(3, 1, 4).GetFromTop(20.f), kParamAmpRelease));
+    PlaceControl(pGraphics, layout, new ICachedCaptionControl(IRECT(), kParamAmpAttack), [](const EditorLayout& l) { return l.mAmpEGValuesArea.GetGridCell(0, 1, 4).GetFromTop(20.f); });
+    PlaceControl(pGraphics, layout, new ICachedCaptionControl(IRECT(), kParamAmpDecay), [](const EditorLayout& l) { return l.mAmpEGValuesArea.GetGridCell(1, 1, 4).GetFromTop(20.f); });
+    PlaceControl(pGraphics, layout, new ICachedCaptionControl(IRECT(), kParamAmpSustain), [](const EditorLayout& l) { return l.mAmpEGValuesArea.GetGridCell(2, 1, 4).GetFromTop(20.f); });
+    PlaceControl(pGraphics, layout, new ICachedCaptionControl(IRECT(), kParamAmpRelease), [](const EditorLayout& l) { return l.mAmpEGValuesArea.GetGridCell(3, 1, 4).GetFromTop(20.f); });
+
+    // how a key struck again while it is still sounding restarts its voice
+    PlaceControl(pGraphics, layout, new IVTabSwitchControl(IRECT(), kParamRetrigger, {}, "Retrigger"), [](const EditorLayout& l) { return l.mRetriggerArea; });
     
     // Master controls
 
     /* TASK_03 -- insert some code here! */
     
-//    pGraphics->AttachControl(new ISVGKnobControl(masterArea.GetCentredInside(100), knobSVG, kParamGain)); /* TASK_02 */
+//    PlaceControl(pGraphics, layout, new SVGKnobControl(IRECT(), knobSVG, kParamGain), [](const EditorLayout& l) { return l.mMasterArea.GetCentredInside(100); }); /* TASK_02 */
+
+    // Morph: store the current sound as either end, then sweep between them with the knob
+    PlaceControl(pGraphics, layout, new IVKnobControl(IRECT(), kParamMorph, "Morph"), [](const EditorLayout& l) { return l.mMorphKnobArea; });
+#if IPLUG_DSP
+    PlaceControl(pGraphics, layout, new IVButtonControl(IRECT(), [this](IControl* pCaller) { SplashClickActionFunc(pCaller); StoreMorphSnapshot(0); }, "Store A"),
+                 [](const EditorLayout& l) { return l.mMorphButtonsArea.GetGridCell(0, 1, 3).GetPadded(-2.f); });
+    PlaceControl(pGraphics, layout, new IVButtonControl(IRECT(), [this](IControl* pCaller) { SplashClickActionFunc(pCaller); StoreMorphSnapshot(1); }, "Store B"),
+                 [](const EditorLayout& l) { return l.mMorphButtonsArea.GetGridCell(1, 1, 3).GetPadded(-2.f); });
+    PlaceControl(pGraphics, layout, new IVButtonControl(IRECT(), [this](IControl* pCaller) { SplashClickActionFunc(pCaller); ClearMorph(); }, "Off"),
+                 [](const EditorLayout& l) { return l.mMorphButtonsArea.GetGridCell(2, 1, 3).GetPadded(-2.f); });
+#endif
+
+    // Presets from a library file
+    PlaceControl(pGraphics, layout, new IVButtonControl(IRECT(), [this](IControl* pCaller) { SplashClickActionFunc(pCaller); ShowPresetMenu(pCaller); }, "Presets"),
+                 [](const EditorLayout& l) { return l.mPresetMenuArea.GetPadded(-2.f); });
     
     // Keyboard
-    pGraphics->AttachControl(new IVKeyboardControl(keyboardArea, 36, 64), kCtrlTagKeyboard);
+    PlaceControl(pGraphics, layout, new IVKeyboardControl(IRECT(), 36, 64), [](const EditorLayout& l) { return l.mKeyboardArea; }, kCtrlTagKeyboard);
 
-    pGraphics->AttachControl(new IVLabelControl(logoArea, "MyNewPlugin", DEFAULT_STYLE.WithDrawFrame(false).WithValueText(IText(50., "Logo"))));
+    PlaceControl(pGraphics, layout, new IVLabelControl(IRECT(), "MyNewPlugin", DEFAULT_STYLE.WithDrawFrame(false).WithValueText(IText(50., "Logo"))), [](const EditorLayout& l) { return l.mLogoArea; });
     
     pGraphics->SetQwertyMidiKeyHandlerFunc([pGraphics](const IMidiMsg& msg) { pGraphics->GetControlWithTag(kCtrlTagKeyboard)->As<IVKeyboardControl>()->SetNoteFromMidi(msg.NoteNumber(), msg.StatusMsg() == IMidiMsg::kNoteOn); });
+
+#if IPLUG_DSP
+    mShownKeyboardState = KeyboardState();
+    mKeyboardStateRequested = true;
+    pGraphics->SetDisplayTickFunc([this, pGraphics]() { UpdateKeyboard(pGraphics); });
+#endif
+
+#if PLUG_PROFILE_EDITOR_FRAMES > 0
+    // a profiling build times every control's drawing, see config.h
+    IDrawProfilerControl* pProfiler = new IDrawProfilerControl(IRECT(), PLUG_PROFILE_EDITOR_FRAMES, {1.f, 2.f}, WriteDrawProfile);
+    pProfiler->SetControlName(pGraphics->GetControlWithTag(kCtrlTagKeyboard), "Keyboard");
+    PlaceControl(pGraphics, layout, pProfiler, [](const EditorLayout& l) { return l.mBounds; });
+
+    // the profiler changes scale on the display tick, between frames
+#if IPLUG_DSP
+    pGraphics->SetDisplayTickFunc([this, pGraphics, pProfiler]() {
+      UpdateKeyboard(pGraphics);
+      pProfiler->OnDisplayTick();
+    });
+#else
+    pGraphics->SetDisplayTickFunc([pProfiler]() { pProfiler->OnDisplayTick(); });
+#endif
+#endif
   };
 #endif
 }
 
+/* EDITOR */
+
+#if IPLUG_EDITOR
+EditorLayout::EditorLayout(const IRECT& bounds)
+{
+  mBounds = bounds;
+  mKeyboardArea = bounds.GetFromBottom(100);
+  mControlsArea = bounds.GetReducedFromBottom(100).GetPadded(-10);
+  mColumn1 = mControlsArea.GetGridCell(0, 1, 3).GetPadded(-10);
+  mColumn2 = mControlsArea.GetGridCell(1, 1, 3).GetPadded(-10);
+  mColumn3 = mControlsArea.GetGridCell(2, 1, 3).GetPadded(-10);
+  mMasterArea = mColumn3.FracRectVertical(0.75, true);
+  mLogoArea = mColumn3.FracRectVertical(0.25, false);
+  mAmpEG = mColumn2.FracRectVertical(0.5, true);
+  mAmpEGLabelsArea = mAmpEG.GetGridCell(0, 3, 1);
+  mAmpEGSlidersArea = mAmpEG.GetGridCell(1, 3, 1);
+  mAmpEGValuesArea = mAmpEG.GetGridCell(2, 3, 1);
+  mRetriggerArea = mColumn2.FracRectVertical(0.5, false).GetPadded(-10).GetFromTop(60.f);
+  mMorphKnobArea = mMasterArea.GetPadded(-10).FracRectVertical(0.6, true);
+  mMorphButtonsArea = mMasterArea.GetPadded(-10).FracRectVertical(0.4, false).GetFromTop(30.f);
+  mPresetMenuArea = mMasterArea.GetPadded(-10).FracRectVertical(0.4, false).GetFromBottom(30.f);
+}
+
+IControl* MyNewPlugin::PlaceControl(IGraphics* pGraphics, const EditorLayout& layout, IControl* pControl, LayoutRule rule, int tag)
+{
+  pGraphics->AttachControl(pControl, tag);
+  pControl->SetTargetAndDrawRECTs(rule(layout));
+  mPlacements.emplace_back(pControl, rule);
+  return pControl;
+}
+
+const ResourceAtlas& MyNewPlugin::GetResourceAtlas(IGraphics* pGraphics)
+{
+  if (!mResourceAtlasSearched)
+  {
+    WDL_String path;
+
+    // only a file on disk can be mapped. Where resources are compiled into the binary they are already in memory
+    if (LocateResource(RESOURCE_ATLAS_FN, "mnra", path, pGraphics->GetBundleID(), pGraphics->GetWinModuleHandle(), pGraphics->GetSharedResourcesSubPath()) == EResourceLocation::kAbsolutePath)
+      mResourceAtlas.Open(path.Get());
+
+    mResourceAtlasSearched = true;
+  }
+
+  return mResourceAtlas;
+}
+
+void MyNewPlugin::LoadFont(IGraphics* pGraphics, const char* fontID, const char* fileName)
+{
+  int size = 0;
+
+  if (const void* pData = GetResourceAtlas(pGraphics).Find(fileName, size))
+    pGraphics->LoadFont(fontID, const_cast<void*>(pData), size);
+  else
+    pGraphics->LoadFont(fontID, fileName);
+}
+
+ISVG MyNewPlugin::LoadSVG(IGraphics* pGraphics, const char* fileName)
+{
+  int size = 0;
+
+  if (const void* pData = GetResourceAtlas(pGraphics).Find(fileName, size))
+    return pGraphics->LoadSVG(fileName, pData, size);
+
+  return pGraphics->LoadSVG(fileName);
+}
+
+void MyNewPlugin::ShowPresetMenu(IControl* pCaller)
+{
+  // every item carries its preset's index as its tag, -1 is the item that opens a library
+  auto onChosen = [this](IPopupMenu* pMenu) {
+    if (IPopupMenu::Item* pItem = pMenu->GetChosenItem())
+    {
+      if (pItem->GetTag() >= 0)
+        LoadLibraryPreset(pItem->GetTag());
+      else
+        PromptForPresetLibrary();
+    }
+  };
+
+  // rebuilt each time it is shown, from the library's sorted entries and its tag index, so nothing is kept in step with the library
+  mPresetMenu.Clear();
+  mPresetMenu.SetFunction(onChosen);
+  mPresetMenu.AddItem(new IPopupMenu::Item("Open Library...", IPopupMenu::Item::kNoFlags, -1));
+
+  if (mPresetLibrary.NPresets())
+  {
+    mPresetMenu.AddSeparator();
+
+    IPopupMenu* pAllMenu = new IPopupMenu();
+    pAllMenu->SetFunction(onChosen);
+
+    for (int i = 0; i < mPresetLibrary.NPresets(); i++)
+      pAllMenu->AddItem(new IPopupMenu::Item(mPresetLibrary.GetName(i), IPopupMenu::Item::kNoFlags, i));
+
+    mPresetMenu.AddItem("All", pAllMenu);
+
+    for (int tag = 0; tag < mPresetLibrary.NTags(); tag++)
+    {
+      IPopupMenu* pTagMenu = new IPopupMenu();
+      pTagMenu->SetFunction(onChosen);
+
+      for (int i = mPresetLibrary.FindTagged(uint64_t(1) << tag); i >= 0; i = mPresetLibrary.FindTagged(uint64_t(1) << tag, i + 1))
+        pTagMenu->AddItem(new IPopupMenu::Item(mPresetLibrary.GetName(i), IPopupMenu::Item::kNoFlags, i));
+
+      mPresetMenu.AddItem(mPresetLibrary.GetTagName(tag), pTagMenu);
+    }
+  }
+
+  GetUI()->CreatePopupMenu(*pCaller, mPresetMenu, pCaller->GetRECT());
+}
+
+void MyNewPlugin::PromptForPresetLibrary()
+{
+  WDL_String fileName, path;
+
+  GetUI()->PromptForFile(fileName, path, EFileAction::Open, "mnpl", [this](const WDL_String& chosenFileName, const WDL_String&) {
+    if (chosenFileName.GetLength())
+      OpenPresetLibrary(chosenFileName.Get());
+  });
+}
+
+#if IPLUG_DSP
+void MyNewPlugin::UpdateKeyboard(IGraphics* pGraphics)
+{
+  KeyboardState state;
+  bool received = false;
+
+  while (mKeyboardStateQueue.Pop(state)) // only the latest one matters
+    received = true;
+
+  if (!received || state == mShownKeyboardState)
+    return;
+
+  IVKeyboardControl* pKeyboard = pGraphics->GetControlWithTag(kCtrlTagKeyboard)->As<IVKeyboardControl>();
+
+  for (int key = 0; key < 128; key++)
+  {
+    if (state.IsHeld(key) != mShownKeyboardState.IsHeld(key))
+      pKeyboard->SetNoteFromMidi(key, state.IsHeld(key));
+  }
+
+  mShownKeyboardState = state;
+}
+#endif
+
+#endif
+
+/* STATE */
+
+// the chunk layout is in PluginState.h
+
+bool MyNewPlugin::SerializeState(IByteChunk& chunk) const
+{
+  PluginState state;
+  state.mNValues = kNumParams;
+
+  for (int i = 0; i < kNumParams; i++)
+    state.mValues[i] = GetParam(i)->Value();
+
+#if IPLUG_DSP
+  std::copy_n(mEngine.mSynth.mVelocityLUT, 128, state.mVelocityLUT);
+  std::copy_n(mEngine.mSynth.mAfterTouchLUT, 128, state.mAfterTouchLUT);
+  state.mTuning = mEngine.mSynth.GetNoteOffset();
+
+  std::lock_guard<std::mutex> lock(mMorphValuesMutex);
+  std::copy_n(mMorphValues, 2 * kNumParams, state.mMorphValues);
+  state.mMorphActive = mMorphValues[2 * kNumParams] != 0.;
+#endif // the editor-only half of a distributed plug-in has no synth, so it writes the default tables, and no morph
+
+  return WriteState(chunk, state);
+}
+
+int MyNewPlugin::UnserializeState(const IByteChunk& chunk, int startPos)
+{
+  PluginState state;
+  const int endPos = ReadState(chunk, startPos, state);
+
+  if (endPos < 0)
+    return -1;
+
+  for (int i = 0; i < kNumParams; i++)
+  {
+    if (i < state.mNValues)
+      GetParam(i)->Set(state.mValues[i]);
+    else // parameters added since the chunk was written
+      GetParam(i)->SetToDefault();
+  }
+
+  OnParamReset(kPresetRecall);
+
+  if (state.mHeaderless) // a factory preset, or state from before it had a header
+    return endPos;
+
+#if IPLUG_DSP
+  for (int i = 0; i < 128; i++)
+  {
+    mEngine.mSynth.mVelocityLUT[i] = Clip(state.mVelocityLUT[i], 0, 127);
+    mEngine.mSynth.mAfterTouchLUT[i] = Clip(state.mAfterTouchLUT[i], 0, 127);
+  }
+
+  mEngine.mSynth.SetNoteOffset(state.mTuning);
+
+  // the ends of the morph, with parameters the chunk doesn't have at their defaults
+  std::lock_guard<std::mutex> lock(mMorphValuesMutex);
+
+  for (int i = 0; i < kNumParams; i++)
+  {
+    const double defaultValue = GetParam(i)->GetDefault(true);
+    mMorphValues[i] = i < state.mNMorphValues ? state.mMorphValues[i] : defaultValue;
+    mMorphValues[kNumParams + i] = i < state.mNMorphValues ? state.mMorphValues[kNumParams + i] : defaultValue;
+  }
+
+  mMorphValues[2 * kNumParams] = state.mMorphActive ? 1. : 0.;
+  mMorphEngine.Prepare(mMorphValues);
+#endif
+
+  return endPos;
+}
+
+bool MyNewPlugin::LoadLibraryPreset(int idx)
+{
+  const double* values = mPresetLibrary.GetValues(idx);
+
+  if (!values)
+    return false;
+
+  // a library built before parameters were added has fewer values, one built by a newer version may have more
+  const int nValues = std::min(mPresetLibrary.NParams(), kNumParams);
+
+  for (int i = 0; i < kNumParams; i++)
+  {
+    if (i < nValues)
+      GetParam(i)->Set(values[i]);
+    else
+      GetParam(i)->SetToDefault();
+
+    // as a gesture, so that the host records the change for automation and undo
+    BeginInformHostOfParamChange(i);
+    InformHostOfParamChange(i, GetParam(i)->GetNormalized());
+    EndInformHostOfParamChange(i);
+  }
+
+  OnParamReset(kPresetRecall);
+  OnRestoreState();
+  InformHostOfPresetChange();
+
+  return true;
+}
+
 #if IPLUG_DSP
 void MyNewPlugin::ProcessBlock(sample** inputs, sample** outputs, int nFrames)
 {
-  mSynth.ProcessBlock(inputs, outputs, 0, 1, nFrames);
+  if (const PresetSnapshot* pSnapshot = mPresetEngine.Acquire())
+  {
+    mEngine.ApplyVoiceSettings(pSnapshot->mVoiceSettings, static_cast<int>(mPresetCrossfadeMs * 0.001 * GetSampleRate()));
+    mEngine.SetRetriggerMode(MakeRetriggerMode(pSnapshot->mValues));
+  }
+
+  // single parameter changes, from the host or the editor, are applied here so that only the audio thread touches the voices
+  if (mVoiceParamsChanged.exchange(false, std::memory_order_acquire))
+  {
+    double values[kNumParams];
+
+    for (int i = 0; i < kNumParams; i++)
+      values[i] = GetParam(i)->Value();
+
+    mEngine.ApplyVoiceSettings(MakeVoiceSettings(values), 0);
+    mEngine.SetRetriggerMode(MakeRetriggerMode(values));
+  }
+
+  if (const MorphEndpoints* pEndpoints = mMorphEngine.Acquire())
+  {
+    mMorph = pEndpoints;
+    mLastMorph = -1.; // force an update
+  }
+
+  // the morph is evaluated once per block, and only when it has moved
+  if (mMorph && mMorph->mActive)
+  {
+    const double morph = GetParam(kParamMorph)->Value() / 100.;
+
+    if (morph != mLastMorph)
+    {
+      UpdateMorph(morph, nFrames);
+      mLastMorph = morph;
+    }
+  }
+
+  mEngine.ProcessBlock(outputs, nFrames);
+
+  // the keyboard shows notes from the host as well as its own. At most one snapshot a block, and only when something changed
+  const KeyboardState keyboardState = mEngine.GetKeyboardState();
+
+  if (keyboardState != mPublishedKeyboardState || mKeyboardStateRequested.load(std::memory_order_relaxed))
+  {
+    if (mKeyboardStateQueue.Push(keyboardState)) // if the queue is full, e.g. while the editor is closed, this is tried again next block
+    {
+      mPublishedKeyboardState = keyboardState;
+      mKeyboardStateRequested.store(false, std::memory_order_relaxed);
+    }
+  }
 
   /* TASK_02 */
   /*
@@ -128,25 +571,134 @@ void MyNewPlugin::ProcessBlock(sample** inputs, sample** outputs, int nFrames)
 
 void MyNewPlugin::ProcessMidiMsg(const IMidiMsg& msg)
 {
-  mSynth.AddMidiMsgToQueue(msg);
+  mEngine.ProcessMidiMsg(msg);
 }
 
 void MyNewPlugin::OnReset()
 {
-  mSynth.SetSampleRateAndBlockSize(GetSampleRate(), GetBlockSize());
+  mEngine.SetSampleRateAndBlockSize(GetSampleRate(), GetBlockSize());
 }
 
-void MyNewPlugin::OnParamChange(int paramIdx)
+void MyNewPlugin::OnActivate(bool active)
 {
-  auto value = GetParam(paramIdx)->Value();
+  // the host is done with us for now, so this is the one place that notes are cut off. A sample rate or block size change keeps them playing
+  if (!active)
+    mEngine.Reset();
+}
+
+void MyNewPlugin::OnParamChange(int paramIdx, EParamSource source, int sampleOffset)
+{
+  // a preset or saved state is applied as a whole in OnRestoreState(), rather than touching every voice once per parameter
+  if (source == kPresetRecall)
+    return;
+
+  // this can be called on any thread, so the voices pick the change up at the start of the next block
   switch (paramIdx) {
-  case kParamAmpAttack:  for(auto* voice : mVoices) { voice->mEnv.SetStageTime(ADSREnvelope<sample>::EStage::kAttack,  value) ; } break;
-  case kParamAmpDecay:   for(auto* voice : mVoices) { voice->mEnv.SetStageTime(ADSREnvelope<sample>::EStage::kDecay,   value); } break;
-  case kParamAmpSustain: for(auto* voice : mVoices) { voice->mSustainLevel = value / 100.0; } break;
-  case kParamAmpRelease: for(auto* voice : mVoices) { voice->mEnv.SetStageTime(ADSREnvelope<sample>::EStage::kRelease, value); } break;
+  case kParamAmpAttack:
+  case kParamAmpDecay:
+  case kParamAmpSustain:
+  case kParamAmpRelease:
+  case kParamRetrigger:
+    mVoiceParamsChanged.store(true, std::memory_order_release);
+    break;
   default:
     break;
   }
 }
 
+void MyNewPlugin::UpdateMorph(double morph, int rampSamples)
+{
+  double values[kNumParams];
+
+  // interpolate normalized values, so that parameter shapes are respected. This is a straight vectorizable pass over the arrays
+  for (int i = 0; i < kNumParams; i++)
+    values[i] = mMorph->mA[i] + morph * (mMorph->mB[i] - mMorph->mA[i]);
+
+  for (int i = 0; i < kNumParams; i++)
+    values[i] = GetParam(i)->FromNormalized(values[i]);
+
+  mEngine.ApplyVoiceSettings(MakeVoiceSettings(values), rampSamples);
+}
+
+void MyNewPlugin::StoreMorphSnapshot(int slot)
+{
+  assert(slot == 0 || slot == 1);
+
+  std::lock_guard<std::mutex> lock(mMorphValuesMutex);
+  const bool wasActive = mMorphValues[2 * kNumParams] != 0.;
+
+  for (int i = 0; i < kNumParams; i++)
+  {
+    const double value = GetParam(i)->GetNormalized();
+    mMorphValues[slot * kNumParams + i] = value;
+
+    if (!wasActive) // start both ends from here, so the morph is never towards all-zero values
+      mMorphValues[(1 - slot) * kNumParams + i] = value;
+  }
+
+  mMorphValues[2 * kNumParams] = 1.;
+  mMorphEngine.Prepare(mMorphValues);
+}
+
+void MyNewPlugin::ClearMorph()
+{
+  std::lock_guard<std::mutex> lock(mMorphValuesMutex);
+  mMorphValues[2 * kNumParams] = 0.;
+  mMorphEngine.Prepare(mMorphValues);
+}
+
+void MyNewPlugin::OnIdle()
+{
+  // dump after a dropout, but not over and over again if the machine is struggling
+  if (mEngine.mRecorder.TakeDeadlineMiss())
+  {
+    const double now = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    if (now - mLastBlackBoxDumpTime > kBlackBoxDumpIntervalSeconds)
+    {
+      DumpBlackBox();
+      mLastBlackBoxDumpTime = now;
+    }
+  }
+}
+
+std::string MyNewPlugin::DumpBlackBox()
+{
+  static std::atomic<int> sNextDump {0}; // shared by every instance
+
+  if (!mEngine.mRecorder.GetEnabled())
+    return "";
+
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/%s-blackbox-%d.mnbb", GetTempDir(), PLUG_NAME, sNextDump.fetch_add(1) % kMaxBlackBoxDumps);
+
+  if (!BlackBoxRecorder::Write(path, mEngine.mRecorder.Snapshot(kBlackBoxSeconds, GetSampleRate())))
+    return "";
+
+  DBGMSG("Black box recording written to %s\n", path);
+  return path;
+}
+
+void MyNewPlugin::OnRestoreState()
+{
+  double values[kNumParams];
+
+  for (int i = 0; i < kNumParams; i++)
+    values[i] = GetParam(i)->Value();
+
+  mPresetEngine.Prepare(values);
+
+  Plugin::OnRestoreState();
+}
+
+#endif
+
+#if IPLUG_DSP && defined WAM_API
+/** Like wam_onmidi, but with the sample offset of the message within the next block, so that events timestamped by the controller land on
+ *  their sample. Called by wam-processor.js on the audio thread, when it drains the shared event ring before calling wam_onprocess */
+extern "C" EMSCRIPTEN_KEEPALIVE void wam_onmidiAt(void* pInst, int status, int data1, int data2, int offset)
+{
+  const IMidiMsg msg(offset, (uint8_t) status, (uint8_t) data1, (uint8_t) data2);
+  dynamic_cast<MyNewPlugin*>(static_cast<WAM::Processor*>(pInst))->ProcessMidiMsg(msg);
+}
 #endif
@@ -1,29 +1,22 @@
 #pragma once
 
 #include "IPlug_include_in_plug_hdr.h"
+#include "PluginState.h"
+#include "PresetLibrary.h"
+
+#if IPLUG_EDITOR
+#include "ResourceAtlas.h"
+#endif
 
 #if IPLUG_DSP
-#include "MidiSynth.h"
+#include "IPlugQueue.h"
 #include "ISender.h"
-#include "MySynthVoice.h"
+#include "MySynthEngine.h"
+#include "PresetEngine.h"
 #endif
 
-const int kNumPresets = 1;
 const int kNumVoices = 32;
-
-enum EParams
-{
-  kParamGain = 0,
-  kParamAmpAttack,
-  kParamAmpDecay,
-  kParamAmpSustain,
-  kParamAmpRelease,
-//  kParamFilterAttack,
-//  kParamFilterDecay,
-//  kParamFilterSustain,
-//  kParamFilterRelease,
-  kNumParams
-};
+const int kKeyboardStateQueueSize = 16;
 
 enum ECtrlTags
 {
@@ -33,17 +26,142 @@ enum ECtrlTags
 using namespace iplug;
 using namespace igraphics;
 
+#if IPLUG_DSP
+/** A complete, ready-to-apply preset: the parameter values and the voice settings derived from them */
+struct PresetSnapshot
+{
+  double mValues[kNumParams] = {};
+  MySynthVoiceSettings mVoiceSettings;
+};
+
+/** The two ends of a morph, as normalized parameter values */
+struct MorphEndpoints
+{
+  double mA[kNumParams] = {};
+  double mB[kNumParams] = {};
+  bool mActive = false;
+};
+#endif
+
+#if IPLUG_EDITOR
+/** The areas of the editor that controls are placed in, worked out from its bounds */
+struct EditorLayout
+{
+  EditorLayout(const IRECT& bounds);
+
+  IRECT mBounds;
+  IRECT mKeyboardArea;
+  IRECT mControlsArea;
+  IRECT mColumn1;
+  IRECT mColumn2;
+  IRECT mColumn3;
+  IRECT mMasterArea;
+  IRECT mLogoArea;
+  IRECT mAmpEG;
+  IRECT mAmpEGLabelsArea;
+  IRECT mAmpEGSlidersArea;
+  IRECT mAmpEGValuesArea;
+  IRECT mRetriggerArea;
+  IRECT mMorphKnobArea;
+  IRECT mMorphButtonsArea;
+  IRECT mPresetMenuArea;
+};
+#endif
+
 class MyNewPlugin final : public Plugin
 {
 public:
   MyNewPlugin(const InstanceInfo& info);
 
+  bool SerializeState(IByteChunk& chunk) const override;
+  int UnserializeState(const IByteChunk& chunk, int startPos) override;
+
+  /** Map a preset library file, replacing any library that was open. Call from the main thread */
+  bool OpenPresetLibrary(const char* path) { return mPresetLibrary.Open(path); }
+
+  /** Apply a preset from the open library, in the same way as a host preset recall, and tell the host about every parameter it changes.
+   * Parameters the library doesn't have are set to their defaults. Call from the main thread */
+  bool LoadLibraryPreset(int idx);
+
+  const PresetLibrary& GetPresetLibrary() const { return mPresetLibrary; }
+
 #if IPLUG_DSP // http://bit.ly/2S64BDd
   void ProcessBlock(sample** inputs, sample** outputs, int nFrames) override;
   void ProcessMidiMsg(const IMidiMsg& msg) override;
   void OnReset() override;
-  void OnParamChange(int paramIdx) override;
-  MidiSynth mSynth;
-  std::vector<MySynthVoice*> mVoices;
+  void OnActivate(bool active) override;
+  void OnParamChange(int paramIdx, EParamSource source, int sampleOffset = -1) override;
+  void OnRestoreState() override;
+  void OnIdle() override;
+  MySynthEngine mEngine;
+  PresetEngine<PresetSnapshot> mPresetEngine;
+  double mPresetCrossfadeMs = 20.; // 0. switches presets instantly
+
+  /** Capture the current parameter values as one end of the morph, and enable morphing. Called by the editor's Store A and Store B buttons,
+   * and saved with the state. Call from the main thread
+   * @param slot 0 for the start (Morph 0%), 1 for the end (Morph 100%) */
+  void StoreMorphSnapshot(int slot);
+
+  /** Stop morphing, leaving voices as they are until the next parameter change */
+  void ClearMorph();
+
+  /** Write the engine's recording of the last few seconds to a file in the temporary folder, for replay with the headless runner.
+   * The last kMaxBlackBoxDumps files are kept, older ones are overwritten. Call from the main thread
+   * @return The path of the file, or an empty string if it couldn't be written or recording isn't enabled (see PLUG_BLACKBOX_RECORDING in config.h) */
+  std::string DumpBlackBox();
+
+private:
+  void UpdateMorph(double morph, int rampSamples);
+
+  PresetEngine<MorphEndpoints> mMorphEngine;
+  double mMorphValues[2 * kNumParams + 1] = {}; // non-realtime copy of the endpoints, plus the active flag. The audio thread only sees what mMorphEngine publishes
+  mutable std::mutex mMorphValuesMutex; // the editor stores endpoints while the host may be saving or restoring the state
+  const MorphEndpoints* mMorph = nullptr;
+  double mLastMorph = -1.;
+  double mLastBlackBoxDumpTime = -1e9; // seconds, for limiting automatic dumps
+  std::atomic<bool> mVoiceParamsChanged {false}; // set by OnParamChange(), picked up by ProcessBlock()
+
+  // what the on-screen keyboard should show, published by the audio thread when it changes
+  IPlugQueue<KeyboardState> mKeyboardStateQueue {kKeyboardStateQueueSize};
+  KeyboardState mPublishedKeyboardState;
+  std::atomic<bool> mKeyboardStateRequested {true}; // publish even if nothing changed, for an editor that has just opened
+#endif
+
+private:
+  PresetLibrary mPresetLibrary;
+
+#if IPLUG_EDITOR
+  /** Picks a control's bounds out of the layout */
+  using LayoutRule = IRECT (*)(const EditorLayout& layout);
+
+  /** Attach a control at the bounds its rule gives, and keep the rule so that a resize can move the control rather than rebuild it */
+  IControl* PlaceControl(IGraphics* pGraphics, const EditorLayout& layout, IControl* pControl, LayoutRule rule, int tag = kNoTag);
+
+  /** The atlas is looked for the first time the editor opens, and stays mapped after that */
+  const ResourceAtlas& GetResourceAtlas(IGraphics* pGraphics);
+
+  /** Load a font from the resource atlas if it has it, otherwise from its own file */
+  void LoadFont(IGraphics* pGraphics, const char* fontID, const char* fileName);
+
+  /** Load an SVG from the resource atlas if it has it, otherwise from its own file */
+  ISVG LoadSVG(IGraphics* pGraphics, const char* fileName);
+
+  /** Pop up the presets of the open library, all of them and by tag, and an item to open a library. Choosing a preset loads it */
+  void ShowPresetMenu(IControl* pCaller);
+
+  /** Ask for a library file and open it, for the preset menu */
+  void PromptForPresetLibrary();
+
+  ResourceAtlas mResourceAtlas;
+  bool mResourceAtlasSearched = false;
+  IPopupMenu mPresetMenu; // outlives the popup, which some platforms show asynchronously
+#if IPLUG_DSP
+  /** Show the latest published keyboard state on the keyboard control, pressing and releasing only the keys that changed.
+   * Called from the display tick on frames after the audio thread has published a state */
+  void UpdateKeyboard(IGraphics* pGraphics);
+
+  KeyboardState mShownKeyboardState;
+#endif
+  std::vector<std::pair<IControl*, LayoutRule>> mPlacements; // every placed control, in the order it was attached
 #endif
 };
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "BlackBoxRecorder.h"
+#include "MidiSynth.h"
+#include "MySynthVoice.h"
+
+/** Which of the 128 MIDI keys are held and which are sounding, as bitmasks. Small enough to pass through a lock-free queue by value */
+struct KeyboardState
+{
+  uint64_t mHeld[2] = {}; // physically held, not counting the sustain pedal
+  uint64_t mSounding[2] = {}; // at least one voice is playing or releasing the key
+
+  static void SetKey(uint64_t* mask, int key) { mask[key >> 6] |= uint64_t(1) << (key & 63); }
+
+  static bool GetKey(const uint64_t* mask, int key) { return (mask[key >> 6] >> (key & 63)) & 1; }
+
+  bool IsHeld(int key) const { return GetKey(mHeld, key); }
+
+  bool IsSounding(int key) const { return GetKey(mSounding, key); }
+
+  bool operator==(const KeyboardState& other) const
+  {
+    return mHeld[0] == other.mHeld[0] && mHeld[1] == other.mHeld[1] && mSounding[0] == other.mSounding[0] && mSounding[1] == other.mSounding[1];
+  }
+
+  bool operator!=(const KeyboardState& other) const { return !(*this == other); }
+};
+
+/** The synthesiser's DSP: a MidiSynth and its voices, with no dependency on a plug-in API or editor.
+ *  The plug-in owns one of these, and so can offline tools such as the headless app, so they all render exactly the same thing. */
+class MySynthEngine
+{
+public:
+  /** @param nVoices The number of voices
+   * @param oscStartPhase Oscillator start phase for every voice, as a fraction of a cycle. Offline renders use this to make round robins */
+  MySynthEngine(int nVoices, double oscStartPhase = 0.)
+  {
+    // one allocation for all the voices, rather than one each, since a session can create a lot of instances
+    mVoiceStorage.reserve(nVoices);
+
+    for (int i = 0; i < nVoices; i++) {
+      mVoiceStorage.emplace_back(oscStartPhase);
+      auto* newVoice = &mVoiceStorage.back(); // never moves, the storage is reserved up front
+      mVoices.push_back(newVoice);
+      mSynth.AddVoice(newVoice, false);
+      newVoice->ApplySettings(mAppliedVoiceSettings, 0); // so that later diffs start from what the voices really have
+    }
+
+    mSynth.SetReuseVoicesForSameKey(true);
+    mSynth.SetSampleAccurateNotes(true);
+  }
+
+  void SetSampleRateAndBlockSize(double sampleRate, int blockSize)
+  {
+    mRecorder.Record(BlackBoxRecorder::kEventReset, mSampleTime.load(std::memory_order_relaxed), blockSize, sampleRate);
+    mSynth.SetSampleRateAndBlockSize(sampleRate, blockSize);
+    mBlockSize = blockSize;
+  }
+
+  /** Silence every voice immediately and forget held keys, so the next render starts from a clean state */
+  void Reset()
+  {
+    mRecorder.Record(BlackBoxRecorder::kEventHardReset, mSampleTime.load(std::memory_order_relaxed), 0);
+    mSynth.Reset();
+  }
+
+  /** Choose how a voice that is still sounding restarts when its key is struck again */
+  void SetRetriggerMode(MySynthVoice::ERetriggerMode mode)
+  {
+    if (mode == mRetriggerMode)
+      return;
+
+    mRecorder.Record(BlackBoxRecorder::kEventRetriggerMode, mSampleTime.load(std::memory_order_relaxed), mode);
+
+    for (auto* voice : mVoices)
+      voice->mRetriggerMode = mode;
+
+    mRetriggerMode = mode;
+  }
+
+  MySynthVoice::ERetriggerMode GetRetriggerMode() const
+  {
+    return mRetriggerMode;
+  }
+
+  /** @see MidiSynth::SetDeterministic() */
+  void SetDeterministic(bool deterministic)
+  {
+    mSynth.SetDeterministic(deterministic);
+  }
+
+  void ProcessMidiMsg(const IMidiMsg& msg)
+  {
+    mRecorder.Record(BlackBoxRecorder::kEventMidi, mSampleTime.load(std::memory_order_relaxed), msg.mStatus << 16 | msg.mData1 << 8 | msg.mData2, msg.mOffset);
+    mSynth.AddMidiMsgToQueue(msg);
+  }
+
+  /** Apply voice settings to every voice, touching only the fields that differ from the last settings applied
+   * @param settings The new settings
+   * @param rampSamples If > 0 the sustain level and the envelope stage rates glide to their new values over this many samples */
+  void ApplyVoiceSettings(const MySynthVoiceSettings& settings, int rampSamples)
+  {
+    const int changed = settings.Diff(mAppliedVoiceSettings);
+
+    if (!changed)
+      return;
+
+    RecordVoiceSettings(settings, rampSamples);
+
+    for (auto* voice : mVoices)
+      voice->ApplySettings(settings, rampSamples, changed);
+
+    mAppliedVoiceSettings = settings;
+  }
+
+  const MySynthVoiceSettings& GetVoiceSettings() const
+  {
+    return mAppliedVoiceSettings;
+  }
+
+  /** Which keys are held and sounding at the end of the last block. Call from the audio thread, between blocks */
+  KeyboardState GetKeyboardState()
+  {
+    KeyboardState state;
+
+    for (const auto& keyPress : mSynth.GetHeldKeys())
+    {
+      if (keyPress.mKey >= 0 && keyPress.mKey < 128)
+        KeyboardState::SetKey(state.mHeld, keyPress.mKey);
+    }
+
+    for (auto* pVoice : mVoices)
+    {
+      const int key = pVoice->mKey >= 0 ? pVoice->mKey : pVoice->mPrevKey; // a released voice has left its key, but is still sounding it
+
+      if (pVoice->GetBusy() && key >= 0 && key < 128)
+        KeyboardState::SetKey(state.mSounding, key);
+    }
+
+    return state;
+  }
+
+  /** Render a block of the (mono) synth into outputs[0]
+   * @return \c true if the synth is silent */
+  bool ProcessBlock(sample** outputs, int nFrames)
+  {
+    const int64_t sampleTime = mSampleTime.load(std::memory_order_relaxed);
+    mSampleTime.store(sampleTime + nFrames, std::memory_order_relaxed);
+
+    if (!mRecorder.GetEnabled())
+      return mSynth.ProcessBlock(nullptr, outputs, 0, 1, nFrames);
+
+    // everything the engine is set up with is recorded again every second, so that a replay of the last few seconds doesn't start from the defaults
+    const double sampleRate = mSynth.GetSampleRate();
+
+    if (sampleTime >= mNextKeyframe)
+    {
+      mRecorder.Record(BlackBoxRecorder::kEventReset, sampleTime, mBlockSize, sampleRate);
+      mRecorder.Record(BlackBoxRecorder::kEventRetriggerMode, sampleTime, mRetriggerMode);
+      mRecorder.Record(BlackBoxRecorder::kEventSettings, sampleTime, 0, mAppliedVoiceSettings.mAttackMs, mAppliedVoiceSettings.mDecayMs,
+                       mAppliedVoiceSettings.mSustainLevel, mAppliedVoiceSettings.mReleaseMs);
+      mNextKeyframe = sampleTime + static_cast<int64_t>(sampleRate);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const bool silent = mSynth.ProcessBlock(nullptr, outputs, 0, 1, nFrames);
+    const double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    mRecorder.Record(BlackBoxRecorder::kEventBlock, sampleTime, nFrames, micros);
+
+    if (micros > 1e6 * nFrames / sampleRate)
+      mRecorder.MarkDeadlineMiss();
+
+    return silent;
+  }
+
+private:
+  std::vector<MySynthVoice> mVoiceStorage; // before mSynth, so that it outlives it
+
+public:
+  MidiSynth mSynth;
+  std::vector<MySynthVoice*> mVoices;
+  BlackBoxRecorder mRecorder; // disabled unless enabled by the owner
+
+private:
+  void RecordVoiceSettings(const MySynthVoiceSettings& settings, int rampSamples)
+  {
+    mRecorder.Record(BlackBoxRecorder::kEventSettings, mSampleTime.load(std::memory_order_relaxed), rampSamples,
+                     settings.mAttackMs, settings.mDecayMs, settings.mSustainLevel, settings.mReleaseMs);
+  }
+
+  MySynthVoiceSettings mAppliedVoiceSettings;
+  MySynthVoice::ERetriggerMode mRetriggerMode = MySynthVoice::kRetriggerLegato;
+  int mBlockSize = 0; // the maximum, as given to SetSampleRateAndBlockSize()
+  std::atomic<int64_t> mSampleTime {0}; // the start of the next block, for the recording. Settings can be applied from other threads
+  int64_t mNextKeyframe = 0;
+};
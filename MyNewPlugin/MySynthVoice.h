@@ -1,44 +1,258 @@
 #pragma once
 
+#include <algorithm>
+
 #include "MidiSynth.h"
 #include "Oscillator.h"
-#include "ADSREnvelope.h"
+#include "SynthTables.h"
+#include "VoiceEnvelope.h"
 
 inline double midi2CPS(double pitch)
 {
-  return 440. * pow(2., (pitch - 69.) / 12.);
+  return SynthTables::Get().PitchToCPS(pitch);
 }
 
+/** Everything a voice needs from the plug-in's parameters, so that a preset can be applied to all voices in one pass */
+struct MySynthVoiceSettings
+{
+  enum EChanged
+  {
+    kAttackChanged = 1 << 0,
+    kDecayChanged = 1 << 1,
+    kSustainChanged = 1 << 2,
+    kReleaseChanged = 1 << 3,
+    kAllChanged = 0xF
+  };
+
+  double mAttackMs = 10.;
+  double mDecayMs = 10.;
+  double mSustainLevel = 0.5;
+  double mReleaseMs = 10.;
+
+  /** @return A mask of EChanged flags for the fields that differ from other */
+  int Diff(const MySynthVoiceSettings& other) const
+  {
+    return (mAttackMs != other.mAttackMs ? kAttackChanged : 0)
+         | (mDecayMs != other.mDecayMs ? kDecayChanged : 0)
+         | (mSustainLevel != other.mSustainLevel ? kSustainChanged : 0)
+         | (mReleaseMs != other.mReleaseMs ? kReleaseChanged : 0);
+  }
+};
+
 class MySynthVoice : public MidiSynth::Voice
 {
-public:  
+public:
+  /** What happens when a voice that is still sounding is triggered again */
+  enum ERetriggerMode
+  {
+    kRetriggerLegato = 0, // the envelope attacks again from its current level and the oscillator carries on, so there is no discontinuity
+    kRetriggerPhaseReset, // the envelope and the oscillator both start again, so every repeat sounds like a fresh note
+    kRetriggerFree, // the envelope starts again from zero but the oscillator carries on
+    kNumRetriggerModes
+  };
+
+  /** The mode a value of the Retrigger parameter, or of a preset's, selects. Out of range values select the nearest mode */
+  static ERetriggerMode RetriggerModeFromValue(double value)
+  {
+    return static_cast<ERetriggerMode>(std::clamp(static_cast<int>(value), 0, kNumRetriggerModes - 1));
+  }
+
+  /** @param oscStartPhase The phase, as a fraction of a cycle, the oscillator starts each note at after a hard kill */
+  MySynthVoice(double oscStartPhase = 0.)
+  : mOsc(oscStartPhase)
+  {
+  }
+
+  /** Apply a complete set of voice settings
+   * @param settings The new settings
+   * @param rampSamples If > 0 the sustain level and the stage rates glide to their new values over this many samples, so that a note in any stage
+   * carries on smoothly rather than stepping to its new level or suddenly changing speed
+   * @param changed Mask of MySynthVoiceSettings::EChanged flags, only these fields are applied */
+  void ApplySettings(const MySynthVoiceSettings& settings, int rampSamples, int changed = MySynthVoiceSettings::kAllChanged)
+  {
+    if (changed & MySynthVoiceSettings::kAttackChanged)
+    {
+      mSettings.mAttackMs = settings.mAttackMs;
+      mEnv.SetStageTime(VoiceEnvelope<sample>::kAttack, settings.mAttackMs, rampSamples);
+    }
+
+    if (changed & MySynthVoiceSettings::kDecayChanged)
+    {
+      mSettings.mDecayMs = settings.mDecayMs;
+      mEnv.SetStageTime(VoiceEnvelope<sample>::kDecay, settings.mDecayMs, rampSamples);
+    }
+
+    if (changed & MySynthVoiceSettings::kReleaseChanged)
+    {
+      mSettings.mReleaseMs = settings.mReleaseMs;
+      mEnv.SetStageTime(VoiceEnvelope<sample>::kRelease, settings.mReleaseMs, rampSamples);
+    }
+
+    if (changed & MySynthVoiceSettings::kSustainChanged)
+    {
+      mSettings.mSustainLevel = settings.mSustainLevel;
+      SetSustainLevel(settings.mSustainLevel, rampSamples);
+    }
+  }
+
+  void SetSustainLevel(sample level, int rampSamples = 0)
+  {
+    mSustainTarget = level;
+
+    if (rampSamples > 0)
+    {
+      mSustainStep = (level - mSustainLevel) / rampSamples;
+      mSustainRampSamples = rampSamples;
+    }
+    else
+    {
+      mSustainLevel = level;
+      mSustainRampSamples = 0;
+    }
+  }
+
+
   void Trigger(double level, bool isRetrigger) override
   {
-    mEnv.Start(level);
+    if (mTriggerOffset > 0 || mNPending > 0) // started by ProcessSamples(), once it reaches the offset
+      AddPendingEvent({mTriggerOffset, false, level, isRetrigger});
+    else
+      Start(level, isRetrigger);
   }
 
   void Release() override
   {
-    mEnv.Release();
+    if (mReleaseOffset > 0 || mNPending > 0) // released by ProcessSamples(), after anything triggered earlier in the slice
+      AddPendingEvent({mReleaseOffset, true, 0., false});
+    else
+      mEnv.Release();
+  }
+
+  void Kill(bool isSoft) override
+  {
+    mNPending = 0;
+    mEnv.Kill(!isSoft);
+
+    if (!isSoft)
+      mOsc.Reset();
   }
   
+  void SetSampleRate(double sampleRate) override
+  {
+    mOsc.SetSampleRate(sampleRate);
+    mEnv.SetSampleRate(sampleRate);
+
+    // the envelope works its stage increments out from the sample rate when a stage time is set, so set them again
+    mEnv.SetStageTime(VoiceEnvelope<sample>::kAttack, mSettings.mAttackMs);
+    mEnv.SetStageTime(VoiceEnvelope<sample>::kDecay, mSettings.mDecayMs);
+    mEnv.SetStageTime(VoiceEnvelope<sample>::kRelease, mSettings.mReleaseMs);
+  }
+
   bool GetBusy() const override
   {
-    return mEnv.GetBusy();
+    return mEnv.GetBusy() || mNPending > 0;
   }
   
   bool GetReleased() const override
   {
-    return mEnv.GetReleased();
+    return mNPending > 0 ? mPending[mNPending - 1].mRelease : mEnv.GetReleased();
   }
   
   void ProcessSamples(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIdx, int nFrames, double pitchBend) override
+  {
+    // pitch can only change between blocks, so the frequency is worked out once rather than per sample
+    const double freqCPS = midi2CPS(mBasePitch + pitchBend);
+    const int endIdx = startIdx + nFrames;
+    int s = startIdx;
+
+    for (int e = 0; e < mNPending; e++)
+    {
+      const int eventIdx = std::min(startIdx + mPending[e].mFrames, endIdx);
+
+      if (mEnv.GetBusy()) // a retriggered or releasing voice plays its previous note up to the event
+        Render(outputs, s, eventIdx - s, freqCPS);
+
+      s = eventIdx;
+      ApplyPendingEvent(mPending[e]);
+    }
+
+    mNPending = 0;
+    Render(outputs, s, endIdx - s, freqCPS);
+  }
+
+private:
+  /** A note start or release waiting for ProcessSamples() to reach it */
+  struct PendingEvent
+  {
+    int mFrames; // into the slice
+    bool mRelease;
+    double mLevel;
+    bool mRetrigger;
+  };
+
+  void AddPendingEvent(PendingEvent event)
+  {
+    if (mNPending == kMaxPendingEvents) // more notes on this voice in one slice than fit, so the oldest happens where the slice starts
+    {
+      ApplyPendingEvent(mPending[0]);
+      std::copy(mPending + 1, mPending + mNPending, mPending);
+      mNPending--;
+    }
+
+    // messages arrive in time order, but don't let an event with no offset jump ahead of ones already waiting
+    if (mNPending > 0)
+      event.mFrames = std::max(event.mFrames, mPending[mNPending - 1].mFrames);
+
+    mPending[mNPending++] = event;
+  }
+
+  void ApplyPendingEvent(const PendingEvent& event)
+  {
+    if (event.mRelease)
+      mEnv.Release();
+    else
+      Start(event.mLevel, event.mRetrigger && mEnv.GetBusy());
+  }
+
+  void Start(double level, bool isRetrigger)
+  {
+    if (!isRetrigger)
+    {
+      SetSustainLevel(mSustainTarget); // ramps that started while the voice was idle have nothing to smooth
+      mEnv.EndStageTimeRamp();
+      mOsc.Reset(); // how far the phase ran on after the last note depends on the block size, so don't carry it over
+      mEnv.Start(level);
+      return;
+    }
+
+    switch (mRetriggerMode)
+    {
+      case kRetriggerLegato:
+        mEnv.Restart(level, mSustainLevel);
+        break;
+      case kRetriggerPhaseReset:
+        mOsc.Reset();
+        mEnv.Start(level);
+        break;
+      default:
+        mEnv.Start(level);
+        break;
+    }
+  }
+
+  void Render(sample** outputs, int startIdx, int nFrames, double freqCPS)
   {
     // for each sample in this block, starting at startIdx
     for (auto s = startIdx; s < startIdx + nFrames; s++)
     {
+      if (mSustainRampSamples > 0)
+      {
+        mSustainLevel += mSustainStep;
+        mSustainRampSamples--;
+      }
+
       // generate 1 samples worth of audio
-      sample y = mEnv.Process(mSustainLevel) * mOsc.Process(midi2CPS(mBasePitch + pitchBend));
+      sample y = mEnv.Process(mSustainLevel) * mOsc.Process(freqCPS);
       
       outputs[0][s] = outputs[0][s] + y; // accumulate the output of this voice into the
     }
@@ -46,6 +260,18 @@ public:
 
 public:
   FastSinOscillator<sample> mOsc;
-  ADSREnvelope<sample> mEnv;
+  VoiceEnvelope<sample> mEnv;
   sample mSustainLevel = 0.;
+  sample mSustainTarget = 0.;
+  sample mSustainStep = 0.;
+  int mSustainRampSamples = 0;
+  ERetriggerMode mRetriggerMode = kRetriggerLegato;
+
+private:
+  MySynthVoiceSettings mSettings; // as applied, for setting the stage times again when the sample rate changes
+
+  // starts and releases waiting for ProcessSamples() to reach their offsets, in time order
+  static constexpr int kMaxPendingEvents = 4;
+  PendingEvent mPending[kMaxPendingEvents];
+  int mNPending = 0;
 };
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cstring>
+
+#include "IPlugStructs.h"
+
+/** The plug-in's parameters, its factory presets and the layout of its state chunk. None of this depends on the plug-in class, so the headless
+ *  runner can check that every factory preset restores every parameter */
+
+enum EParams
+{
+  kParamGain = 0,
+  kParamAmpAttack,
+  kParamAmpDecay,
+  kParamAmpSustain,
+  kParamAmpRelease,
+//  kParamFilterAttack,
+//  kParamFilterDecay,
+//  kParamFilterSustain,
+//  kParamFilterRelease,
+  kParamMorph,
+  kParamRetrigger,
+  kNumParams
+};
+
+/** A factory preset: parameter values as the host shows them (not normalized), in EParams order */
+struct FactoryPreset
+{
+  const char* mName;
+  double mValues[kNumParams];
+};
+
+static constexpr FactoryPreset kFactoryPresets[] = {
+  // name     gain  attack decay  sustain release morph retrigger
+  {"Init",  {0.,   10.,   10.,   50.,    10.,    0.,   0.}},
+  {"Pluck", {0.,   1.,    250.,  0.,     150.,   0.,   1.}},
+  {"Pad",   {0.,   800.,  400.,  80.,    1000.,  0.,   0.}},
+  {"Organ", {0.,   2.,    10.,   100.,   5.,     0.,   0.}},
+};
+
+constexpr int kNumPresets = sizeof(kFactoryPresets) / sizeof(kFactoryPresets[0]);
+
+// State chunk layout. All fields are little-endian, which is the native byte order of every platform we ship on,
+// so tables are written straight out of (and read straight back into) their arrays without any conversion.
+//
+//   int32   kStateMagic
+//   int32   state version
+//   int32   size in bytes of the body that follows, so that an older build can skip fields a newer build appends
+//   int32   number of parameter values that follow (version 2 on. In version 1 it follows from the body size)
+//   double  parameter values [count] (as IPluginBase::SerializeParams writes them)
+//   int32   velocity curve [128]
+//   int32   aftertouch curve [128]
+//   double  tuning offset in semitones
+//   int32   1 if morphing, else 0 (version 2 on)
+//   double  normalized values at Morph 0% [count], then at Morph 100% [count] (version 2 on)
+//
+// A chunk without the magic number is just parameter values, as many as fit: that is what state was before it had a header, and what a
+// factory preset is.
+//
+// New fields must only ever be appended to the end of the body, and bump kStateVersion. Parameters must only ever be appended
+// to EParams, and a chunk with fewer of them leaves the rest at their defaults.
+static constexpr int kStateMagic = 'MNPS';
+static constexpr int kStateVersion = 2;
+static constexpr int kVersion1FixedBodySize = 2 * 128 * sizeof(int) + sizeof(double); // a version 1 body, less its parameter values
+
+/** Everything a state chunk holds, in fixed size arrays so that reading a chunk never allocates */
+struct PluginState
+{
+  PluginState()
+  {
+    for (int i = 0; i < 128; i++)
+    {
+      mVelocityLUT[i] = i;
+      mAfterTouchLUT[i] = i;
+    }
+  }
+
+  int mNValues = 0; // how many parameter values the chunk has, which may be more or fewer than kNumParams
+  double mValues[kNumParams] = {};
+  bool mHeaderless = false; // the chunk is just parameter values, and has none of the fields below
+  int mVelocityLUT[128];
+  int mAfterTouchLUT[128];
+  double mTuning = 0.;
+  bool mMorphActive = false;
+  int mNMorphValues = 0; // how many values each end of the morph has, 0 before version 2
+  double mMorphValues[2 * kNumParams] = {}; // normalized, at Morph 0% then at Morph 100%
+};
+
+/** Read nValues doubles, keeping the first kNumParams of them, as a chunk from a newer build may have more
+ * @return The position after the values, or -1 if the chunk is too short */
+static int ReadStateValues(const iplug::IByteChunk& chunk, int pos, int nValues, double* pValues)
+{
+  for (int i = 0; i < nValues && pos >= 0; i++)
+  {
+    double value = 0.;
+    pos = chunk.Get(&value, pos);
+
+    if (i < kNumParams) // values for parameters this build doesn't have are skipped
+      pValues[i] = value;
+  }
+
+  return pos;
+}
+
+/** Read a state chunk into state, without applying anything, so that a truncated chunk can't be half applied
+ * @return The position after the state, skipping anything a newer version appended, or -1 if the chunk isn't valid */
+static int ReadState(const iplug::IByteChunk& chunk, int startPos, PluginState& state)
+{
+  int magic = 0;
+  int version = 0;
+  int bodySize = 0;
+  int pos = chunk.Get(&magic, startPos);
+
+  if (pos < 0 || magic != kStateMagic)
+  {
+    state.mHeaderless = true;
+    state.mNValues = (chunk.Size() - startPos) / (int) sizeof(double);
+
+    if (startPos < 0 || state.mNValues < 1)
+      return -1;
+
+    return ReadStateValues(chunk, startPos, state.mNValues, state.mValues);
+  }
+
+  pos = chunk.Get(&version, pos);
+  pos = pos < 0 ? pos : chunk.Get(&bodySize, pos);
+
+  if (pos < 0 || bodySize < 0 || pos + bodySize > chunk.Size())
+    return -1;
+
+  const int bodyEndPos = pos + bodySize;
+
+  if (version >= 2)
+    pos = chunk.Get(&state.mNValues, pos);
+  else
+    state.mNValues = (bodySize - kVersion1FixedBodySize) / (int) sizeof(double);
+
+  if (pos < 0 || state.mNValues < 0 || state.mNValues > (bodyEndPos - pos) / (int) sizeof(double))
+    return -1;
+
+  pos = ReadStateValues(chunk, pos, state.mNValues, state.mValues);
+  pos = pos < 0 ? pos : chunk.GetBytes(state.mVelocityLUT, sizeof(state.mVelocityLUT), pos);
+  pos = pos < 0 ? pos : chunk.GetBytes(state.mAfterTouchLUT, sizeof(state.mAfterTouchLUT), pos);
+  pos = pos < 0 ? pos : chunk.Get(&state.mTuning, pos);
+
+  if (version >= 2)
+  {
+    int morphActive = 0;
+    pos = pos < 0 ? pos : chunk.Get(&morphActive, pos);
+    pos = pos < 0 ? pos : ReadStateValues(chunk, pos, state.mNValues, state.mMorphValues);
+    pos = pos < 0 ? pos : ReadStateValues(chunk, pos, state.mNValues, state.mMorphValues + kNumParams);
+    state.mMorphActive = morphActive != 0;
+    state.mNMorphValues = state.mNValues;
+  }
+
+  if (pos < 0 || pos > bodyEndPos)
+    return -1;
+
+  return bodyEndPos;
+}
+
+/** Write state as a chunk of the current version, with kNumParams values */
+static bool WriteState(iplug::IByteChunk& chunk, const PluginState& state)
+{
+  const int magic = kStateMagic;
+  const int version = kStateVersion;
+  const int nValues = kNumParams;
+  const int morphActive = state.mMorphActive ? 1 : 0;
+  int bodySize = 0;
+
+  chunk.Put(&magic);
+  chunk.Put(&version);
+  const int bodySizePos = chunk.Size();
+  chunk.Put(&bodySize);
+  const int bodyStartPos = chunk.Size();
+
+  chunk.Put(&nValues);
+  chunk.PutBytes(state.mValues, sizeof(state.mValues));
+  chunk.PutBytes(state.mVelocityLUT, sizeof(state.mVelocityLUT));
+  chunk.PutBytes(state.mAfterTouchLUT, sizeof(state.mAfterTouchLUT));
+  chunk.Put(&state.mTuning);
+  chunk.Put(&morphActive);
+  chunk.PutBytes(state.mMorphValues, sizeof(state.mMorphValues));
+
+  // patch in the body size now that we know it
+  bodySize = chunk.Size() - bodyStartPos;
+  memcpy(chunk.GetData() + bodySizePos, &bodySize, sizeof(int));
+
+  return true;
+}
+
+/** A factory preset's chunk, which is just its parameter values, as IPluginBase::MakePreset() writes them. Recalling one sets the parameters,
+ * and leaves the curves, tuning and morph as they are */
+static void MakeFactoryPresetChunk(const FactoryPreset& preset, iplug::IByteChunk& chunk)
+{
+  chunk.PutBytes(preset.mValues, sizeof(preset.mValues));
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "WorkerPool.h"
+
+/** Prepares complete parameter/coefficient snapshots away from the audio thread and hands them over at a block boundary.
+ *  The snapshot type is whatever the plug-in needs to apply a preset in one go (parameter values plus anything derived from them).
+ *  Hand over uses a lock-free triple buffer, so the audio thread never waits and never allocates: it either picks up the most
+ *  recently published snapshot with a single atomic exchange, or carries on with the one it has.
+ *  Snapshots are prepared on the process-wide WorkerPool's background lane, one at a time per engine.
+ *  Where there are no threads (WORKER_POOL_HAS_THREADS is 0) Prepare() fills in the snapshot itself, before it returns. */
+template <class TSnapshot>
+class PresetEngine
+{
+public:
+  /** Fills in a snapshot from a full set of parameter values. Called on a WorkerPool thread, or by Prepare() where there are no threads */
+  using PrepareFunc = std::function<void(const double* values, int nValues, TSnapshot& snapshot)>;
+
+  PresetEngine(int nValues, PrepareFunc prepareFunc)
+  : mPrepareFunc(prepareFunc)
+  , mRequestedValues(nValues, 0.)
+  , mWorkingValues(nValues, 0.)
+  , mWorkers(2) // one task running, plus room for the next while the previous one is still returning
+  {
+  }
+
+  PresetEngine(const PresetEngine&) = delete;
+  PresetEngine& operator=(const PresetEngine&) = delete;
+
+  /** Request a new snapshot. Call from any non-realtime thread, or from the only thread there is on targets without threads.
+   * If several requests arrive before the worker gets to them, only the latest is prepared
+   * @param values Pointer to nValues parameter values, which are copied */
+  void Prepare(const double* values)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+#if !WORKER_POOL_HAS_THREADS
+    std::copy(values, values + mWorkingValues.size(), mWorkingValues.begin());
+    Publish();
+#else
+    std::copy(values, values + mRequestedValues.size(), mRequestedValues.begin());
+    mRequested = true;
+
+    // a task that is already running will pick the new values up before it finishes
+    if (!mTaskQueued)
+      mTaskQueued = mWorkers.Submit(WorkerPool::kLaneBackground, [this]() { PrepareTask(); });
+#endif
+  }
+
+  /** Call on the audio thread at the start of a block
+   * @return The newly published snapshot if there is one, otherwise \c nullptr. The pointer stays valid until the next call */
+  const TSnapshot* Acquire()
+  {
+    if (!(mPending.load(std::memory_order_relaxed) & kNewFlag))
+      return nullptr;
+
+    mReadIdx = mPending.exchange(mReadIdx, std::memory_order_acq_rel) & kIdxMask;
+    return &mSlots[mReadIdx];
+  }
+
+private:
+  void PrepareTask()
+  {
+    for (;;)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if (!mRequested)
+        {
+          mTaskQueued = false;
+          return;
+        }
+
+        mWorkingValues.swap(mRequestedValues);
+        mRequested = false;
+      }
+
+      Publish();
+    }
+  }
+
+  /** Fill in the write slot from mWorkingValues and hand it to the audio thread */
+  void Publish()
+  {
+    mPrepareFunc(mWorkingValues.data(), (int) mWorkingValues.size(), mSlots[mWriteIdx]);
+    mWriteIdx = mPending.exchange(mWriteIdx | kNewFlag, std::memory_order_acq_rel) & kIdxMask;
+  }
+
+  static constexpr int kIdxMask = 0x3;
+  static constexpr int kNewFlag = 0x4;
+
+  TSnapshot mSlots[3];
+  int mWriteIdx = 0; // owned by the worker
+  int mReadIdx = 1; // owned by the audio thread
+  std::atomic<int> mPending {2};
+
+  PrepareFunc mPrepareFunc;
+  std::vector<double> mRequestedValues;
+  std::vector<double> mWorkingValues;
+  std::mutex mMutex;
+  bool mRequested = false;
+  bool mTaskQueued = false;
+  WorkerPool::Client mWorkers; // last, so that it waits for a running task before anything else is destroyed
+};
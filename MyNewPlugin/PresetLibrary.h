@@ -0,0 +1,437 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "MappedFile.h"
+
+/** A read-only library of presets stored in a single memory-mapped file.
+ *  Opening a library only maps the file and checks its header, so it takes the same time for ten presets as for ten thousand.
+ *  Presets are sorted by (ASCII case-insensitive) name, so lookup by name or prefix is a binary search, and each preset's values
+ *  are read straight out of the mapping without any parsing. Each tag has a sorted list of the presets that have it, so filtering by tags
+ *  is a binary search in each list rather than a scan of every preset.
+ *
+ *  File layout, all little-endian, offsets in bytes from the start of the file:
+ *
+ *    Header
+ *    Entry[nPresets]            sorted by name
+ *    double[nPresets][nParams]  8-byte aligned
+ *    uint32_t[nTags]            offset of each tag name in the string table
+ *    uint32_t[nTags + 1]        tag index: where each tag's presets start in the list that follows, and where the last one ends
+ *    uint32_t[]                 for each tag, the indices of the presets that have it, ascending
+ *    char[stringsSize]          null-terminated UTF-8 preset and tag names
+ *
+ *  Version 1 files have no tag index (mTagIndexOffset is 0), and are filtered by scanning the entries.
+ *
+ *  A library may have been built with more or fewer parameters than the plug-in now has: parameters are only ever appended, so a reader
+ *  takes the first min(NParams(), its own count) values of each preset and leaves the rest at their defaults, as it does with saved state.
+ *
+ *  Libraries can be built with scripts/make_preset_library.py, or with PresetLibrary::Write() e.g. for user presets. */
+class PresetLibrary
+{
+public:
+  static constexpr uint32_t kVersion = 2;
+  static constexpr int kMaxTags = 64;
+
+  struct Header
+  {
+    char mMagic[4];
+    uint32_t mVersion;
+    uint32_t mNPresets;
+    uint32_t mNParams;
+    uint32_t mNTags;
+    uint32_t mEntriesOffset;
+    uint32_t mValuesOffset;
+    uint32_t mTagNamesOffset;
+    uint32_t mStringsOffset;
+    uint32_t mStringsSize;
+    uint32_t mFileSize;
+    uint32_t mTagIndexOffset; // 0 if there is no tag index
+  };
+
+  struct Entry
+  {
+    uint64_t mTags; // bit n set if the preset has tag n
+    uint32_t mNameOffset; // into the string table
+    uint32_t mNameLength; // excluding the terminator
+    uint32_t mValuesRow;
+    uint32_t mFlags;
+  };
+
+  static_assert(sizeof(Header) == 48, "PresetLibrary::Header must match the file layout");
+  static_assert(sizeof(Entry) == 24, "PresetLibrary::Entry must match the file layout");
+
+  /** Used to build a library with Write() */
+  struct PresetData
+  {
+    std::string mName;
+    uint64_t mTags = 0;
+    std::vector<double> mValues;
+  };
+
+  PresetLibrary() = default;
+  ~PresetLibrary() { Close(); }
+
+  PresetLibrary(const PresetLibrary&) = delete;
+  PresetLibrary& operator=(const PresetLibrary&) = delete;
+
+  /** Map a library file. Call from a non-realtime thread
+   * @param path UTF-8 path to the file
+   * @return \c true if the file was mapped and its header is valid */
+  bool Open(const char* path)
+  {
+    Close();
+
+    if (!mFile.Map(path))
+      return false;
+
+    if (!Validate())
+    {
+      Close();
+      return false;
+    }
+
+    return true;
+  }
+
+  void Close()
+  {
+    mFile.Unmap();
+    mHeader = nullptr;
+    mEntries = nullptr;
+    mValues = nullptr;
+    mTagNames = nullptr;
+    mTagIndex = nullptr;
+    mTagPresets = nullptr;
+    mStrings = nullptr;
+  }
+
+  bool IsOpen() const { return mHeader != nullptr; }
+
+  int NPresets() const { return mHeader ? (int) mHeader->mNPresets : 0; }
+
+  int NTags() const { return mHeader ? (int) mHeader->mNTags : 0; }
+
+  /** @return The number of values each preset has, which needn't be the number of parameters the plug-in has now */
+  int NParams() const { return mHeader ? (int) mHeader->mNParams : 0; }
+
+  /** @return The number of presets with the tag, or -1 if the library has no tag index */
+  int NTagged(int tagIdx) const
+  {
+    if (!mTagIndex || tagIdx < 0 || tagIdx >= NTags())
+      return -1;
+
+    return (int) (mTagIndex[tagIdx + 1] - mTagIndex[tagIdx]);
+  }
+
+  /** @return The preset's name, or an empty string if idx is out of range */
+  const char* GetName(int idx) const
+  {
+    const Entry* pEntry = GetEntry(idx);
+    return pEntry ? mStrings + pEntry->mNameOffset : "";
+  }
+
+  uint64_t GetTags(int idx) const
+  {
+    const Entry* pEntry = GetEntry(idx);
+    return pEntry ? pEntry->mTags : 0;
+  }
+
+  const char* GetTagName(int tagIdx) const
+  {
+    if (!mHeader || tagIdx < 0 || tagIdx >= NTags() || mTagNames[tagIdx] >= mHeader->mStringsSize)
+      return "";
+
+    return mStrings + mTagNames[tagIdx];
+  }
+
+  /** @return Pointer to the preset's NParams() parameter values, which live in the mapping, or \c nullptr if idx is out of range */
+  const double* GetValues(int idx) const
+  {
+    const Entry* pEntry = GetEntry(idx);
+    return pEntry ? mValues + (size_t) pEntry->mValuesRow * mHeader->mNParams : nullptr;
+  }
+
+  /** @return The index of the first preset whose name is not less than prefix, i.e. the start of the presets beginning with prefix */
+  int LowerBound(const char* prefix) const
+  {
+    const Entry* pBegin = mEntries;
+    const Entry* pEnd = mEntries + NPresets();
+    const size_t prefixLen = strlen(prefix);
+
+    const Entry* pFound = std::lower_bound(pBegin, pEnd, prefix, [&](const Entry& entry, const char* str) {
+      return CompareNoCase(mStrings + entry.mNameOffset, entry.mNameLength, str, prefixLen) < 0;
+    });
+
+    return (int) (pFound - pBegin);
+  }
+
+  /** @return The index of the preset called name, or -1 */
+  int Find(const char* name) const
+  {
+    const int idx = LowerBound(name);
+    const size_t len = strlen(name);
+
+    if (idx < NPresets() && CompareNoCase(GetName(idx), mEntries[idx].mNameLength, name, len) == 0)
+      return idx;
+
+    return -1;
+  }
+
+  /** @return true if the preset's name starts with prefix. Use with LowerBound() to walk the presets matching a prefix */
+  bool StartsWith(int idx, const char* prefix) const
+  {
+    const Entry* pEntry = GetEntry(idx);
+    const size_t len = strlen(prefix);
+    return pEntry && pEntry->mNameLength >= len && CompareNoCase(mStrings + pEntry->mNameOffset, (uint32_t) len, prefix, len) == 0;
+  }
+
+  /** @return The index of the next preset at or after startIdx that has all the tags in mask, or -1. With a tag index this is a binary
+   * search in the list of each tag in mask, leapfrogging between them until they agree, so walking the matches doesn't visit the rest */
+  int FindTagged(uint64_t mask, int startIdx = 0) const
+  {
+    startIdx = (std::max)(startIdx, 0);
+
+    if (!mTagIndex || !mask)
+    {
+      for (int i = startIdx; i < NPresets(); i++)
+      {
+        if ((mEntries[i].mTags & mask) == mask)
+          return i;
+      }
+
+      return -1;
+    }
+
+    if (NTags() < kMaxTags && mask >> NTags()) // a tag the library doesn't have
+      return -1;
+
+    uint32_t candidate = (uint32_t) startIdx;
+
+    while (candidate < mHeader->mNPresets)
+    {
+      bool agreed = true;
+
+      for (int tag = 0; tag < NTags(); tag++)
+      {
+        if (!((mask >> tag) & 1))
+          continue;
+
+        const uint32_t* pBegin = mTagPresets + mTagIndex[tag];
+        const uint32_t* pEnd = mTagPresets + mTagIndex[tag + 1];
+        const uint32_t* pFound = std::lower_bound(pBegin, pEnd, candidate);
+
+        if (pFound == pEnd || *pFound < candidate) // the end of the tag's presets, or a list that isn't sorted
+          return -1;
+
+        if (*pFound != candidate)
+        {
+          candidate = *pFound; // a later candidate, that every tag so far has to be checked for again
+          agreed = false;
+          break;
+        }
+      }
+
+      // the index is checked as it is used, like the entries, and a preset that it gets wrong is skipped
+      if (agreed)
+      {
+        if (candidate < mHeader->mNPresets && (mEntries[candidate].mTags & mask) == mask)
+          return (int) candidate;
+
+        candidate++;
+      }
+    }
+
+    return -1;
+  }
+
+  /** Write a library file. Presets are sorted by name on the way out. Call from a non-realtime thread
+   * @return \c true on success */
+  static bool Write(const char* path, std::vector<PresetData> presets, const std::vector<std::string>& tagNames, int nParams)
+  {
+    if (tagNames.size() > kMaxTags)
+      return false;
+
+    std::sort(presets.begin(), presets.end(), [](const PresetData& a, const PresetData& b) {
+      return CompareNoCase(a.mName.c_str(), (uint32_t) a.mName.size(), b.mName.c_str(), b.mName.size()) < 0;
+    });
+
+    std::vector<Entry> entries(presets.size());
+    std::vector<double> values(presets.size() * nParams, 0.);
+    std::vector<uint32_t> tagOffsets;
+    std::vector<uint32_t> tagIndex;
+    std::string strings;
+
+    for (size_t i = 0; i < presets.size(); i++)
+    {
+      entries[i].mTags = presets[i].mTags;
+      entries[i].mNameOffset = (uint32_t) strings.size();
+      entries[i].mNameLength = (uint32_t) presets[i].mName.size();
+      entries[i].mValuesRow = (uint32_t) i;
+      entries[i].mFlags = 0;
+      strings.append(presets[i].mName.c_str(), presets[i].mName.size() + 1);
+      std::copy_n(presets[i].mValues.begin(), (std::min)(presets[i].mValues.size(), (size_t) nParams), values.begin() + i * nParams);
+    }
+
+    for (const auto& tagName : tagNames)
+    {
+      tagOffsets.push_back((uint32_t) strings.size());
+      strings.append(tagName.c_str(), tagName.size() + 1);
+    }
+
+    // the starts of each tag's list, then the lists, which come out ascending since the presets are already sorted
+    std::vector<uint32_t> tagPresets;
+
+    for (size_t tag = 0; tag < tagNames.size(); tag++)
+    {
+      tagIndex.push_back((uint32_t) tagPresets.size());
+
+      for (size_t i = 0; i < entries.size(); i++)
+      {
+        if ((entries[i].mTags >> tag) & 1)
+          tagPresets.push_back((uint32_t) i);
+      }
+    }
+
+    tagIndex.push_back((uint32_t) tagPresets.size());
+    tagIndex.insert(tagIndex.end(), tagPresets.begin(), tagPresets.end());
+
+    Header header = {};
+    memcpy(header.mMagic, "MNPL", 4);
+    header.mVersion = kVersion;
+    header.mNPresets = (uint32_t) presets.size();
+    header.mNParams = (uint32_t) nParams;
+    header.mNTags = (uint32_t) tagNames.size();
+    header.mEntriesOffset = sizeof(Header);
+    header.mValuesOffset = header.mEntriesOffset + (uint32_t) (entries.size() * sizeof(Entry)); // entries are 24 bytes, so this stays 8-byte aligned
+    header.mTagNamesOffset = header.mValuesOffset + (uint32_t) (values.size() * sizeof(double));
+    header.mTagIndexOffset = header.mTagNamesOffset + (uint32_t) (tagOffsets.size() * sizeof(uint32_t));
+    header.mStringsOffset = header.mTagIndexOffset + (uint32_t) (tagIndex.size() * sizeof(uint32_t));
+    header.mStringsSize = (uint32_t) strings.size();
+    header.mFileSize = header.mStringsOffset + header.mStringsSize;
+
+    FILE* pFile = fopen(path, "wb");
+
+    if (!pFile)
+      return false;
+
+    bool ok = fwrite(&header, sizeof(Header), 1, pFile) == 1;
+    ok = ok && fwrite(entries.data(), sizeof(Entry), entries.size(), pFile) == entries.size();
+    ok = ok && fwrite(values.data(), sizeof(double), values.size(), pFile) == values.size();
+    ok = ok && fwrite(tagOffsets.data(), sizeof(uint32_t), tagOffsets.size(), pFile) == tagOffsets.size();
+    ok = ok && fwrite(tagIndex.data(), sizeof(uint32_t), tagIndex.size(), pFile) == tagIndex.size();
+    ok = ok && fwrite(strings.data(), 1, strings.size(), pFile) == strings.size();
+    ok = (fclose(pFile) == 0) && ok;
+
+    return ok;
+  }
+
+private:
+  const Entry* GetEntry(int idx) const
+  {
+    if (idx < 0 || idx >= NPresets())
+      return nullptr;
+
+    const Entry* pEntry = mEntries + idx;
+
+    // entries are checked as they are used, so that opening doesn't have to visit every one of them
+    if (pEntry->mValuesRow >= mHeader->mNPresets || (uint64_t) pEntry->mNameOffset + pEntry->mNameLength >= mHeader->mStringsSize)
+      return nullptr;
+
+    return pEntry;
+  }
+
+  static int CompareNoCase(const char* a, uint32_t aLen, const char* b, size_t bLen)
+  {
+    const size_t n = (std::min)((size_t) aLen, bLen);
+
+    for (size_t i = 0; i < n; i++)
+    {
+      const int ca = ToLower((unsigned char) a[i]);
+      const int cb = ToLower((unsigned char) b[i]);
+
+      if (ca != cb)
+        return ca < cb ? -1 : 1;
+    }
+
+    return aLen == bLen ? 0 : (aLen < bLen ? -1 : 1);
+  }
+
+  static int ToLower(int c) { return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c; }
+
+  bool Validate()
+  {
+    if (mFile.GetSize() < sizeof(Header))
+      return false;
+
+    const Header* pHeader = reinterpret_cast<const Header*>(mFile.GetData());
+
+    if (memcmp(pHeader->mMagic, "MNPL", 4) != 0 || pHeader->mVersion > kVersion || pHeader->mFileSize > mFile.GetSize())
+      return false;
+
+    if (pHeader->mNTags > kMaxTags)
+      return false;
+
+    // every array is read in place, so has to be aligned for its type
+    if (pHeader->mEntriesOffset % alignof(Entry) || pHeader->mValuesOffset % alignof(double) || pHeader->mTagNamesOffset % alignof(uint32_t) ||
+        pHeader->mTagIndexOffset % alignof(uint32_t))
+      return false;
+
+    const uint64_t entriesEnd = pHeader->mEntriesOffset + (uint64_t) pHeader->mNPresets * sizeof(Entry);
+    const uint64_t valuesEnd = pHeader->mValuesOffset + (uint64_t) pHeader->mNPresets * pHeader->mNParams * sizeof(double);
+    const uint64_t tagNamesEnd = pHeader->mTagNamesOffset + (uint64_t) pHeader->mNTags * sizeof(uint32_t);
+    const uint64_t stringsEnd = pHeader->mStringsOffset + (uint64_t) pHeader->mStringsSize;
+
+    if (entriesEnd > pHeader->mFileSize || valuesEnd > pHeader->mFileSize || tagNamesEnd > pHeader->mFileSize || stringsEnd > pHeader->mFileSize)
+      return false;
+
+    if (pHeader->mStringsSize && mFile.GetData()[pHeader->mStringsOffset + pHeader->mStringsSize - 1] != 0) // so that every name is terminated
+      return false;
+
+    const uint32_t* pTagIndex = nullptr;
+
+    if (pHeader->mVersion >= 2 && pHeader->mTagIndexOffset)
+    {
+      // the starts are one per tag, so checking them doesn't depend on the number of presets. The lists themselves are checked as they are used
+      const uint64_t startsEnd = pHeader->mTagIndexOffset + (uint64_t) (pHeader->mNTags + 1) * sizeof(uint32_t);
+
+      if (startsEnd > pHeader->mFileSize)
+        return false;
+
+      pTagIndex = reinterpret_cast<const uint32_t*>(mFile.GetData() + pHeader->mTagIndexOffset);
+
+      for (uint32_t tag = 0; tag < pHeader->mNTags; tag++)
+      {
+        if (pTagIndex[tag] > pTagIndex[tag + 1])
+          return false;
+      }
+
+      if (pTagIndex[0] != 0 || startsEnd + (uint64_t) pTagIndex[pHeader->mNTags] * sizeof(uint32_t) > pHeader->mFileSize)
+        return false;
+    }
+
+    mHeader = pHeader;
+    mEntries = reinterpret_cast<const Entry*>(mFile.GetData() + pHeader->mEntriesOffset);
+    mValues = reinterpret_cast<const double*>(mFile.GetData() + pHeader->mValuesOffset);
+    mTagNames = reinterpret_cast<const uint32_t*>(mFile.GetData() + pHeader->mTagNamesOffset);
+    mTagIndex = pTagIndex;
+    mTagPresets = pTagIndex ? pTagIndex + pHeader->mNTags + 1 : nullptr;
+    mStrings = reinterpret_cast<const char*>(mFile.GetData() + pHeader->mStringsOffset);
+
+    return true;
+  }
+
+  MappedFile mFile;
+
+  const Header* mHeader = nullptr;
+  const Entry* mEntries = nullptr;
+  const double* mValues = nullptr;
+  const uint32_t* mTagNames = nullptr;
+  const uint32_t* mTagIndex = nullptr; // nullptr for a library without one
+  const uint32_t* mTagPresets = nullptr;
+  const char* mStrings = nullptr;
+};
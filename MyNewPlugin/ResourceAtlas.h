@@ -0,0 +1,189 @@
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <cstring>
+
+#include "MappedFile.h"
+
+/** The editor's fonts and SVGs packed into a single memory-mapped file, built by scripts/make_resource_atlas.py.
+ *  Opening the atlas only maps the file and checks its header, and each resource is handed to IGraphics from the mapping,
+ *  so the editor doesn't have to find, open and read every resource file separately each time it opens.
+ *  What is packed is the raw file contents (SVGs minified), not anything pre-parsed: IGraphics still copies each resource, parses every SVG
+ *  and loads every font at runtime, just as it does from separate files. Only macOS and iOS builds ship an atlas, see RESOURCE_ATLAS_FN.
+ *
+ *  File layout, all little-endian, offsets in bytes from the start of the file:
+ *
+ *    Header
+ *    Entry[nEntries]            sorted by name, byte-wise
+ *    char[stringsSize]          null-terminated UTF-8 resource names, the file names the resources were packed from
+ *    data                       each resource 16-byte aligned and followed by a null byte, which isn't counted in its size */
+class ResourceAtlas
+{
+public:
+  static constexpr uint32_t kVersion = 1;
+
+  enum EType
+  {
+    kTypeOther = 0,
+    kTypeFont,
+    kTypeSVG
+  };
+
+  struct Header
+  {
+    char mMagic[4];
+    uint32_t mVersion;
+    uint32_t mNEntries;
+    uint32_t mEntriesOffset;
+    uint32_t mStringsOffset;
+    uint32_t mStringsSize;
+    uint32_t mFileSize;
+    uint32_t mReserved;
+  };
+
+  struct Entry
+  {
+    uint32_t mNameOffset; // into the string table
+    uint32_t mNameLength; // excluding the terminator
+    uint32_t mType; // EType
+    uint32_t mFlags;
+    uint64_t mDataOffset;
+    uint64_t mDataSize;
+  };
+
+  static_assert(sizeof(Header) == 32, "ResourceAtlas::Header must match the file layout");
+  static_assert(sizeof(Entry) == 32, "ResourceAtlas::Entry must match the file layout");
+
+  ResourceAtlas() = default;
+
+  ResourceAtlas(const ResourceAtlas&) = delete;
+  ResourceAtlas& operator=(const ResourceAtlas&) = delete;
+
+  /** Map an atlas file, replacing any atlas that was open. Call from a non-realtime thread
+   * @param path UTF-8 path to the file
+   * @return \c true if the file was mapped and its header is valid */
+  bool Open(const char* path)
+  {
+    Close();
+
+    if (!mFile.Map(path))
+      return false;
+
+    if (!Validate())
+    {
+      Close();
+      return false;
+    }
+
+    return true;
+  }
+
+  void Close()
+  {
+    mFile.Unmap();
+    mHeader = nullptr;
+    mEntries = nullptr;
+    mStrings = nullptr;
+  }
+
+  bool IsOpen() const { return mHeader != nullptr; }
+
+  int NEntries() const { return mHeader ? (int) mHeader->mNEntries : 0; }
+
+  /** Look up a resource by the file name it was packed from
+   * @param name e.g. \c "Roboto-Regular.ttf"
+   * @param size Set to the size of the resource in bytes
+   * @return The resource's data, or \c nullptr if the atlas isn't open or doesn't have it */
+  const void* Find(const char* name, int& size) const
+  {
+    size = 0;
+
+    if (!mHeader)
+      return nullptr;
+
+    const size_t nameLength = strlen(name);
+    int lo = 0;
+    int hi = (int) mHeader->mNEntries - 1;
+
+    while (lo <= hi)
+    {
+      const int mid = (lo + hi) / 2;
+      const Entry& entry = mEntries[mid];
+      const int cmp = Compare(mStrings + entry.mNameOffset, entry.mNameLength, name, nameLength);
+
+      if (cmp == 0)
+      {
+        size = (int) entry.mDataSize;
+        return mFile.GetData() + entry.mDataOffset;
+      }
+
+      if (cmp < 0)
+        lo = mid + 1;
+      else
+        hi = mid - 1;
+    }
+
+    return nullptr;
+  }
+
+private:
+  static int Compare(const char* a, size_t aLen, const char* b, size_t bLen)
+  {
+    const int cmp = memcmp(a, b, aLen < bLen ? aLen : bLen);
+
+    if (cmp != 0)
+      return cmp;
+
+    return aLen == bLen ? 0 : (aLen < bLen ? -1 : 1);
+  }
+
+  bool Validate()
+  {
+    const uint8_t* pData = mFile.GetData();
+    const size_t size = mFile.GetSize();
+
+    if (size < sizeof(Header))
+      return false;
+
+    const Header* pHeader = reinterpret_cast<const Header*>(pData);
+
+    if (memcmp(pHeader->mMagic, "MNRA", 4) != 0 || pHeader->mVersion > kVersion || pHeader->mFileSize > size || pHeader->mEntriesOffset % alignof(Entry))
+      return false;
+
+    const uint64_t entriesEnd = pHeader->mEntriesOffset + (uint64_t) pHeader->mNEntries * sizeof(Entry);
+    const uint64_t stringsEnd = pHeader->mStringsOffset + (uint64_t) pHeader->mStringsSize;
+
+    if (entriesEnd > pHeader->mFileSize || stringsEnd > pHeader->mFileSize)
+      return false;
+
+    if (pHeader->mStringsSize && pData[stringsEnd - 1] != 0) // so that every name is terminated
+      return false;
+
+    const Entry* pEntries = reinterpret_cast<const Entry*>(pData + pHeader->mEntriesOffset);
+
+    for (uint32_t i = 0; i < pHeader->mNEntries; i++)
+    {
+      const Entry& entry = pEntries[i];
+
+      if ((uint64_t) entry.mNameOffset + entry.mNameLength >= pHeader->mStringsSize)
+        return false;
+
+      // offset and size are both 64 bit, so check them separately rather than adding them, which could wrap around. The data is followed by a null byte
+      if (entry.mDataOffset >= pHeader->mFileSize || entry.mDataSize >= pHeader->mFileSize - entry.mDataOffset || entry.mDataSize > INT_MAX)
+        return false;
+    }
+
+    mHeader = pHeader;
+    mEntries = pEntries;
+    mStrings = reinterpret_cast<const char*>(pData + pHeader->mStringsOffset);
+
+    return true;
+  }
+
+  MappedFile mFile;
+
+  const Header* mHeader = nullptr;
+  const Entry* mEntries = nullptr;
+  const char* mStrings = nullptr;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cmath>
+
+/** Read-only DSP tables shared by every voice of every instance in the process.
+ *  They are built lazily the first time Get() is called, and C++11 guarantees that initialisation of the function-local static is thread safe,
+ *  so instances created concurrently by the host will wait for the one build rather than each making their own copy. */
+class SynthTables
+{
+public:
+  static constexpr int kMinPitch = -12;
+  static constexpr int kMaxPitch = 140;
+  static constexpr int kStepsPerSemitone = 64;
+  static constexpr int kPitchTableSize = (kMaxPitch - kMinPitch) * kStepsPerSemitone + 2; // + guard point for interpolation
+
+  static const SynthTables& Get()
+  {
+    static const SynthTables sTables;
+    return sTables;
+  }
+
+  /** Convert a (fractional) MIDI pitch to a frequency in Hz, by linear interpolation of a 1/64th semitone table
+   * @param pitch MIDI pitch, where 69 is A4 at 440 Hz
+   * @return Frequency in Hz */
+  inline double PitchToCPS(double pitch) const
+  {
+    if (pitch < kMinPitch || pitch >= kMaxPitch)
+      return 440. * std::pow(2., (pitch - 69.) / 12.);
+
+    const double pos = (pitch - kMinPitch) * kStepsPerSemitone;
+    const int idx = static_cast<int>(pos);
+    const double frac = pos - idx;
+    return mPitchToCPS[idx] + frac * (mPitchToCPS[idx + 1] - mPitchToCPS[idx]);
+  }
+
+  SynthTables(const SynthTables&) = delete;
+  SynthTables& operator=(const SynthTables&) = delete;
+
+private:
+  SynthTables()
+  {
+    for (int i = 0; i < kPitchTableSize; i++)
+      mPitchToCPS[i] = 440. * std::pow(2., ((double) i / kStepsPerSemitone + kMinPitch - 69.) / 12.);
+  }
+
+  double mPitchToCPS[kPitchTableSize];
+};
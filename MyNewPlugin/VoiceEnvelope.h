@@ -0,0 +1,259 @@
+#pragma once
+
+#include <cmath>
+
+/** An ADSR envelope with the same stages and curves as iPlug's ADSREnvelope (linear attack, exponential decay and release,
+ *  a short linear fade for a soft kill), which can also restart from wherever it is. ADSREnvelope can only attack from zero,
+ *  and its Retrigger() fades to zero before it does, so a voice retriggered legato would dip */
+template <typename T>
+class VoiceEnvelope
+{
+public:
+  enum EStage
+  {
+    kKilling = -2, // fading out quickly after a soft kill
+    kIdle = -1,
+    kAttack,
+    kDecay,
+    kSustain,
+    kRelease
+  };
+
+  static constexpr T kEarlyReleaseThreshold = 0.01; // an exponential stage ends once it is this close to its target
+  static constexpr T kKillTimeMs = 3.;
+
+  VoiceEnvelope()
+  {
+    SetSampleRate(44100.);
+  }
+
+  /** Set the sample rate. Stage times set before this must be set again, as with ADSREnvelope */
+  void SetSampleRate(double sampleRate)
+  {
+    mSampleRate = sampleRate;
+    mKillIncr = CalcIncrFromTimeLinear(kKillTimeMs);
+  }
+
+  /** @param stage kAttack, kDecay or kRelease
+   * @param timeMs The length of the stage
+   * @param rampSamples If > 0 the stage's rate glides to its new value over this many samples, so that a note in the stage doesn't
+   * suddenly rush or stall. Setting another stage time with a ramp restarts the glide of every stage that hasn't reached its target */
+  void SetStageTime(int stage, double timeMs, int rampSamples = 0)
+  {
+    T* pIncr = nullptr;
+    T* pTarget = nullptr;
+
+    switch (stage)
+    {
+      case kAttack: pIncr = &mAttackIncr; pTarget = &mAttackTarget; *pTarget = CalcIncrFromTimeLinear(timeMs); break;
+      case kDecay: pIncr = &mDecayIncr; pTarget = &mDecayTarget; *pTarget = CalcIncrFromTimeExp(timeMs); break;
+      case kRelease: pIncr = &mReleaseIncr; pTarget = &mReleaseTarget; *pTarget = CalcIncrFromTimeExp(timeMs); break;
+      default: return;
+    }
+
+    if (rampSamples > 0)
+    {
+      mIncrRampSamples = rampSamples;
+      mAttackStep = (mAttackTarget - mAttackIncr) / rampSamples;
+      mDecayStep = (mDecayTarget - mDecayIncr) / rampSamples;
+      mReleaseStep = (mReleaseTarget - mReleaseIncr) / rampSamples;
+    }
+    else
+    {
+      *pIncr = *pTarget;
+
+      if (stage == kAttack) mAttackStep = 0.;
+      else if (stage == kDecay) mDecayStep = 0.;
+      else mReleaseStep = 0.;
+    }
+  }
+
+  /** Finish gliding the stage rates now, e.g. for a note starting from silence, which has nothing to smooth */
+  void EndStageTimeRamp()
+  {
+    mIncrRampSamples = 0;
+    mAttackIncr = mAttackTarget;
+    mDecayIncr = mDecayTarget;
+    mReleaseIncr = mReleaseTarget;
+  }
+
+  /** Start a note from zero
+   * @param level The peak level */
+  void Start(T level)
+  {
+    mStage = kAttack;
+    mEnvValue = 0.;
+    mLevel = level;
+  }
+
+  /** Start a note from the level the envelope is at now, so there is no discontinuity: from below the new peak the attack carries on
+   * up from there at its usual rate, and from above it the envelope decays from there to the new sustain level
+   * @param level The peak level
+   * @param sustainLevel The sustain level the next Process() calls will be given */
+  void Restart(T level, T sustainLevel)
+  {
+    const T current = mPrevOutput;
+
+    if (level <= 0.)
+    {
+      Start(level);
+      return;
+    }
+
+    mLevel = level;
+
+    if (current <= level || sustainLevel >= 1.)
+    {
+      mStage = kAttack;
+      mEnvValue = current < level ? current / level : 1.;
+    }
+    else
+    {
+      // the decay's output is mEnvValue * (1 - sustainLevel) + sustainLevel, so solve that for the current level
+      mStage = kDecay;
+      mEnvValue = (current / level - sustainLevel) / (1. - sustainLevel);
+    }
+  }
+
+  void Release()
+  {
+    if (mStage == kIdle)
+      return;
+
+    mStage = kRelease;
+    mReleaseLevel = mPrevResult;
+    mEnvValue = 1.;
+  }
+
+  /** @param hard \c true to stop now, \c false to fade out over kKillTimeMs */
+  void Kill(bool hard)
+  {
+    if (hard)
+    {
+      mStage = kIdle;
+      mEnvValue = 0.;
+      mPrevResult = 0.;
+      mPrevOutput = 0.;
+    }
+    else if (mStage != kIdle)
+    {
+      mStage = kKilling;
+      mReleaseLevel = mPrevResult;
+      mEnvValue = 1.;
+    }
+  }
+
+  bool GetBusy() const { return mStage != kIdle; }
+
+  bool GetReleased() const { return mStage == kIdle || mStage == kRelease || mStage == kKilling; }
+
+  /** @return The last value Process() returned */
+  T GetPrevOutput() const { return mPrevOutput; }
+
+  inline T Process(T sustainLevel = 0.)
+  {
+    T result = 0.;
+
+    if (mIncrRampSamples > 0)
+    {
+      if (--mIncrRampSamples == 0)
+        EndStageTimeRamp();
+      else
+      {
+        mAttackIncr += mAttackStep;
+        mDecayIncr += mDecayStep;
+        mReleaseIncr += mReleaseStep;
+      }
+    }
+
+    switch (mStage)
+    {
+      case kIdle:
+        break;
+      case kAttack:
+        mEnvValue += mAttackIncr;
+
+        if (mEnvValue > 1. || mAttackIncr == 0.)
+        {
+          mStage = kDecay;
+          mEnvValue = 1.;
+        }
+
+        result = mEnvValue;
+        break;
+      case kDecay:
+        mEnvValue -= mDecayIncr * mEnvValue;
+        result = mEnvValue * (1. - sustainLevel) + sustainLevel;
+
+        if (mEnvValue < kEarlyReleaseThreshold || mDecayIncr == 0.)
+        {
+          mStage = kSustain;
+          result = sustainLevel;
+        }
+        break;
+      case kSustain:
+        result = sustainLevel;
+        break;
+      case kRelease:
+        mEnvValue -= mReleaseIncr * mEnvValue;
+
+        if (mEnvValue < kEarlyReleaseThreshold || mReleaseIncr == 0.)
+        {
+          mStage = kIdle;
+          mEnvValue = 0.;
+        }
+
+        result = mEnvValue * mReleaseLevel;
+        break;
+      case kKilling:
+        mEnvValue -= mKillIncr;
+
+        if (mEnvValue < 0.)
+        {
+          mStage = kIdle;
+          mEnvValue = 0.;
+        }
+
+        result = mEnvValue * mReleaseLevel;
+        break;
+    }
+
+    mPrevResult = result;
+    mPrevOutput = result * mLevel;
+    return mPrevOutput;
+  }
+
+private:
+  T CalcIncrFromTimeLinear(double timeMs) const
+  {
+    return timeMs <= 0. ? 0. : static_cast<T>((1. / mSampleRate) / (timeMs / 1000.));
+  }
+
+  T CalcIncrFromTimeExp(double timeMs) const
+  {
+    if (timeMs <= 0.)
+      return 0.;
+
+    const double r = -std::expm1(1000. * std::log(0.001) / (mSampleRate * timeMs));
+    return static_cast<T>(r < 1. ? r : 1.);
+  }
+
+  double mSampleRate = 44100.;
+  T mAttackIncr = 0.;
+  T mDecayIncr = 0.;
+  T mReleaseIncr = 0.;
+  T mAttackTarget = 0.; // what the rates are gliding to, see SetStageTime()
+  T mDecayTarget = 0.;
+  T mReleaseTarget = 0.;
+  T mAttackStep = 0.;
+  T mDecayStep = 0.;
+  T mReleaseStep = 0.;
+  int mIncrRampSamples = 0;
+  T mKillIncr = 0.;
+  T mEnvValue = 0.; // progress through the current stage
+  T mReleaseLevel = 0.; // what the release or kill fades from
+  T mLevel = 0.; // the note's peak level
+  T mPrevResult = 0.; // the last output, before scaling by mLevel
+  T mPrevOutput = 0.;
+  int mStage = kIdle;
+};
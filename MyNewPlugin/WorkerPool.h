@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a WebAssembly build without pthreads can't start threads, so code that hands work to the pool has to do it on the calling thread there
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define WORKER_POOL_HAS_THREADS 0
+#else
+#define WORKER_POOL_HAS_THREADS 1
+#endif
+
+/** A pool of worker threads shared by every plug-in instance in the process, so that a session with a hundred instances
+ *  doesn't start a hundred sets of helper threads. The pool is created when the first task is submitted, so loading instances that have nothing
+ *  for it to do starts no threads, and it is shut down when the last Client that used it goes away.
+ *  Tasks are queued in priority lanes; a worker always takes the oldest task from the highest priority lane that has one.
+ *  Each instance talks to the pool through its own Client, which limits how many tasks it can have queued or running per lane.
+ *  Submitting allocates, so it should not be done from the audio thread.
+ *  Where WORKER_POOL_HAS_THREADS is 0 the pool has no threads, and Submit() runs each task before it returns. */
+class WorkerPool
+{
+public:
+  enum ELane
+  {
+    kLaneRealtimeAssist = 0, // work the audio thread is waiting on
+    kLaneStreaming, // work that has a deadline, e.g. disk streaming
+    kLaneBackground, // everything else, e.g. preparing presets
+    kNumLanes
+  };
+
+  class Client
+  {
+  public:
+    /** @param quota The maximum number of tasks this client can have queued or running in each lane */
+    Client(int quota = 4)
+    : mQuota(quota)
+    {
+    }
+
+    /** Waits for this client's outstanding tasks, so they can safely refer to the object that owns the client */
+    ~Client()
+    {
+      WaitForAll();
+    }
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    /** Queue a task
+     * @return \c false if the client has reached its quota for this lane, in which case the task is not queued */
+    bool Submit(ELane lane, std::function<void()> task)
+    {
+#if !WORKER_POOL_HAS_THREADS
+      task();
+      return true;
+#else
+      {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if (mInFlight[lane] >= mQuota)
+          return false;
+
+        if (!mPool)
+          mPool = WorkerPool::Acquire();
+
+        mInFlight[lane]++;
+      }
+
+      mPool->Enqueue(lane, this, std::move(task));
+      return true;
+#endif
+    }
+
+    /** Block until every task this client submitted has finished */
+    void WaitForAll()
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mIdle.wait(lock, [this]() {
+        return std::all_of(mInFlight, mInFlight + kNumLanes, [](int n) { return n == 0; });
+      });
+    }
+
+    /** @return The number of threads in the pool, or 0 before this client has submitted anything */
+    int NThreads() const { return mPool ? mPool->NThreads() : 0; }
+
+  private:
+    void TaskFinished(ELane lane)
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mInFlight[lane]--;
+      mIdle.notify_all(); // while still holding the lock, so the client can't be destroyed under us
+    }
+
+    std::shared_ptr<WorkerPool> mPool; // set under mMutex by the first Submit(), and never changed after
+    const int mQuota;
+    int mInFlight[kNumLanes] = {};
+    std::mutex mMutex;
+    std::condition_variable mIdle;
+
+    friend class WorkerPool;
+  };
+
+  /** @return The process-wide pool, created if this is the first reference */
+  static std::shared_ptr<WorkerPool> Acquire()
+  {
+    static std::mutex sMutex;
+    static std::weak_ptr<WorkerPool> sPool;
+
+    std::lock_guard<std::mutex> lock(sMutex);
+    std::shared_ptr<WorkerPool> pool = sPool.lock();
+
+    if (!pool)
+    {
+      pool.reset(new WorkerPool());
+      sPool = pool;
+    }
+
+    return pool;
+  }
+
+  ~WorkerPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mQuit = true;
+    }
+
+    mWakeUp.notify_all();
+
+    for (auto& thread : mThreads)
+      thread.join();
+  }
+
+  int NThreads() const { return (int) mThreads.size(); }
+
+private:
+  struct Task
+  {
+    std::function<void()> mFunc;
+    Client* mClient;
+  };
+
+  WorkerPool()
+  {
+#if WORKER_POOL_HAS_THREADS
+    // leave a core for the host's own audio thread
+    const int nThreads = (std::max)((int) std::thread::hardware_concurrency() - 1, 1);
+
+    for (int i = 0; i < nThreads; i++)
+      mThreads.emplace_back([this]() { WorkerLoop(); });
+#endif
+  }
+
+  void Enqueue(ELane lane, Client* pClient, std::function<void()> func)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mLanes[lane].push_back({std::move(func), pClient});
+    }
+
+    mWakeUp.notify_one();
+  }
+
+  void WorkerLoop()
+  {
+    for (;;)
+    {
+      Task task;
+      int lane = 0;
+
+      {
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        mWakeUp.wait(lock, [this]() {
+          return mQuit || std::any_of(mLanes, mLanes + kNumLanes, [](const std::deque<Task>& q) { return !q.empty(); });
+        });
+
+        // clients wait for their own tasks before they go away, so there is never anything left to run here
+        if (mQuit)
+          return;
+
+        while (mLanes[lane].empty())
+          lane++;
+
+        task = std::move(mLanes[lane].front());
+        mLanes[lane].pop_front();
+      }
+
+      task.mFunc();
+      task.mClient->TaskFinished(static_cast<ELane>(lane));
+    }
+  }
+
+  std::vector<std::thread> mThreads;
+  std::deque<Task> mLanes[kNumLanes];
+  std::mutex mMutex;
+  std::condition_variable mWakeUp;
+  bool mQuit = false;
+};
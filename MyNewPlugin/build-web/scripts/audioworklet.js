@@ -10,9 +10,9 @@ AudioContext = window.AudioContext || window.webkitAudioContext;
   "use strict";
 
   // namespace to avoid global scope pollution
-  // disabling SABs for now
+  // SharedArrayBuffers can only be shared with workers when the page is cross-origin isolated
   window.AWPF = window.AWPF || {}
-  AWPF.hasSAB = false; // window.SharedArrayBuffer !== undefined;
+  AWPF.hasSAB = window.SharedArrayBuffer !== undefined && window.crossOriginIsolated !== false;
   AWPF.origin = "";
 
   // --------------------------------------------------------------------------
@@ -187,17 +187,22 @@ AudioContext = window.AudioContext || window.webkitAudioContext;
       spn.disconnect();
     }
 
-    if (AWPF.hasSAB)  var outbuf = new Float32Array(audioOut[0]);  // spn limitation
+    if (AWPF.hasSAB) {
+      var inbufs  = audioIn ? audioIn.map(function (sab) { return new Float32Array(sab); }) : [];
+      var outbufs = audioOut.map(function (sab) { return new Float32Array(sab); });
+    }
 
     var onprocess = function (ape) {
       if (this.processor === undefined) return;
 
       var ibuff = ape.inputBuffer;
       var obuff = ape.outputBuffer;
-      var outL  = obuff.getChannelData(0);
 
       if (AWPF.hasSAB) {
-        outL.set(outbuf);
+        for (var c=0; c<inbufs.length; c++)
+          inbufs[c].set(ibuff.getChannelData(c));
+        for (var c=0; c<outbufs.length; c++)
+          obuff.getChannelData(c).set(outbufs[c]);
         var msg = { type:"process", processor:this.processor, time:context.currentTime };
         AWPF.worker.postMessage(msg);
       }
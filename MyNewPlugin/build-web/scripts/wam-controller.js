@@ -18,22 +18,96 @@ class WAMController extends AudioWorkletNode
         self.onmessage(msg);
       }
     }
+
+    // -- event ring shared with the processor, when SharedArrayBuffers are available. otherwise events go by postMessage
+    this.ring = null;
+    var hasSAB = window.AWPF ? AWPF.hasSAB : (window.SharedArrayBuffer !== undefined && window.crossOriginIsolated !== false);
+    if (hasSAB) {
+      var sab = new SharedArrayBuffer(WAMController.RING_HEADER_BYTES + WAMController.RING_CAPACITY);
+      this.ring = {
+        indices: new Int32Array(sab, 0, 2),
+        view: new DataView(sab, WAMController.RING_HEADER_BYTES),
+        bytes: new Uint8Array(sab, WAMController.RING_HEADER_BYTES),
+        capacity: WAMController.RING_CAPACITY
+      };
+      this.port.postMessage({ type:"ring", data:sab });
+    }
+  }
+
+  // -- the event ring is a single producer, single consumer queue of records in a SharedArrayBuffer:
+  //      Int32 writeIndex, Int32 readIndex, then RING_CAPACITY bytes of records
+  //    each record is 16-byte aligned: Uint32 type, Uint32 payload size in bytes, Float64 time, payload
+  //    time is in AudioContext seconds, 0 meaning as soon as possible. the processor delivers events at their sample within the render quantum
+  //    they fall in, and leaves events for later quanta in the ring, so events should be written in time order
+  //    a record of type RING_WRAP means the next record is at the start of the ring
+  static get RING_HEADER_BYTES () { return 8; }
+  static get RING_CAPACITY () { return 64*1024; }
+  static get RING_WRAP ()  { return 0; }
+  static get RING_MIDI ()  { return 1; }
+  static get RING_PARAM () { return 2; }
+  static get RING_PATCH () { return 3; }
+  static get RING_SYSEX () { return 4; }
+
+  // writes a record with a payload of size bytes, filled by fill(view, byteOffset).
+  // returns false if the ring isn't in use or hasn't room, and the event should be posted instead
+  writeRing (type, time, size, fill) {
+    var ring = this.ring;
+    if (!ring) return false;
+
+    var recordSize = (16 + size + 15) & ~15;
+    var write = Atomics.load(ring.indices, 0);
+    var read  = Atomics.load(ring.indices, 1);
+    var free  = (read - write - 16 + ring.capacity) % ring.capacity; // one record of slack, so that a full ring isn't mistaken for an empty one
+    if (write + recordSize > ring.capacity) {
+      if (recordSize + ring.capacity - write > free) return false;
+      ring.view.setUint32(write, WAMController.RING_WRAP, true);
+      write = 0;
+    }
+    else if (recordSize > free) return false;
+
+    ring.view.setUint32(write, type, true);
+    ring.view.setUint32(write + 4, size, true);
+    ring.view.setFloat64(write + 8, time || 0, true);
+    fill(ring.view, write + 16);
+    Atomics.store(ring.indices, 0, (write + recordSize) % ring.capacity);
+    return true;
+  }
+
+  // -- time is optional, in AudioContext seconds. events without one are handled at the start of the next render quantum
+  setParam(key,value,time) {
+    if (typeof key !== "number" || !this.writeRing(WAMController.RING_PARAM, time, 12, function (view, i) {
+      view.setFloat64(i, value, true);
+      view.setInt32(i + 8, key, true);
+    }))
+      this.port.postMessage({ type:"param", key:key, value:value });
   }
 
-  setParam(key,value) {
-    this.port.postMessage({ type:"param", key:key, value:value });
+  setPatch(patch,time) {
+    if (!this.writeBytes(WAMController.RING_PATCH, time, patch))
+      this.port.postMessage({ type:"patch", data:patch });
   }
 
-  setPatch(patch) {
-    this.port.postMessage({ type:"patch", data:patch });
+  setSysex(sysex,time) {
+    if (!this.writeBytes(WAMController.RING_SYSEX, time, sysex))
+      this.port.postMessage({ type:"sysex", data:sysex });
   }
 
-  setSysex(sysex) {
-    this.port.postMessage({ type:"sysex", data:sysex });
+  onMidi(msg,time) {
+    if (!this.writeRing(WAMController.RING_MIDI, time, 3, function (view, i) {
+      view.setUint8(i, msg[0]);
+      view.setUint8(i + 1, msg[1]);
+      view.setUint8(i + 2, msg[2]);
+    }))
+      this.port.postMessage({ type:"midi", data:msg });
   }
 
-  onMidi(msg) {
-    this.port.postMessage({ type:"midi", data:msg });
+  // data is an ArrayBuffer, typed array or array of byte values
+  writeBytes (type, time, data) {
+    var bytes = data instanceof ArrayBuffer ? new Uint8Array(data) : data;
+    var ring = this.ring;
+    return this.writeRing(type, time, bytes.length, function (view, i) {
+      ring.bytes.set(bytes, i);
+    });
   }
 
   set midiIn (port) {
@@ -43,10 +117,15 @@ class WAMController extends AudioWorkletNode
     }
     this._midiInPort = port;
     this._midiInPort.onmidimessage = function (msg) {
-      this.port.postMessage({ type:"midi", data:msg.data });
+      this.onMidi(msg.data);
     }.bind(this);
   }
 
+  // -- frees the processor's instance. the node outputs silence after this, and should be disconnected
+  terminate() {
+    this.port.postMessage({ type:"terminate" });
+  }
+
   sendMessage(verb, prop, data) {
     this.port.postMessage({ type:"msg", verb:verb, prop:prop, data:data });
   }
@@ -48,6 +48,10 @@ class WAMProcessor extends AudioWorkletProcessor
     // -- supress warnings for older WAMs
     if (WAM["_wam_onmessageA"])
       this.wam_onmessageA = WAM.cwrap("wam_onmessageA", null, ['number','string','string','number','number']);
+
+    // -- sample accurate midi from the event ring, where the WAM provides it
+    if (WAM["_wam_onmidiAt"])
+      this.wam_onmidiAt = WAM.cwrap("wam_onmidiAt", null, ['number','number','number','number','number']);
     
     this.inst = wam_ctor();
     var desc  = wam_init(this.inst, this.bufsize, this.sr, "");
@@ -81,6 +85,13 @@ class WAMProcessor extends AudioWorkletProcessor
       }
     }
 
+    // -- transfer arena for patch, sysex and array message data, so that messages don't allocate on the audio thread
+    this.arenaSize = 64*1024;
+    this.arena = WAM._malloc(this.arenaSize);
+
+    // -- event ring shared by the controller, see WAMController.writeRing for the layout
+    this.ring = null;
+
     this.port.onmessage = this.onmessage.bind(this);
     this.port.start();
     
@@ -93,12 +104,15 @@ class WAMProcessor extends AudioWorkletProcessor
   onmessage (e) {
     var msg  = e.data;
     var data = msg.data;
+    if (!this.inst) return;
     switch (msg.type) {
       case "midi":  this.onmidi(data[0], data[1], data[2]); break;
       case "sysex": this.onsysex(data); break;
       case "patch": this.onpatch(data); break;
       case "param": this.onparam(msg.key, msg.value); break;
       case "msg":   this.onmsg(msg.verb, msg.prop, msg.data); break;
+      case "ring":  this.onring(data); break;
+      case "terminate": this.onterminate(); break;
     //case "osc":   this.onmsg(msg.prop, msg.type, msg.data); break;
     }
   }
@@ -113,16 +127,25 @@ class WAMProcessor extends AudioWorkletProcessor
     else this.wam_onparam(this.inst, key, value);
   }
   
+  // copies bytes (ArrayBuffer, typed array or array of numbers) into the transfer arena, and returns its address in WASM memory.
+  // the arena is only reallocated when a message is larger than any before it
+  toArena (bytes) {
+    var WAM = this.WAM;
+    var len = bytes.byteLength !== undefined ? bytes.byteLength : bytes.length;
+    if (len > this.arenaSize) {
+      WAM._free(this.arena);
+      while (this.arenaSize < len) this.arenaSize *= 2;
+      this.arena = WAM._malloc(this.arenaSize);
+    }
+    // HEAPU8 is looked up each time, since the heap is replaced if memory grows
+    WAM.HEAPU8.set(bytes instanceof ArrayBuffer ? new Uint8Array(bytes) : bytes, this.arena);
+    return this.arena;
+  }
+
   onmsg (verb, prop, data) {
     if (data instanceof ArrayBuffer) {
-      var buffer = new Uint8Array(data);
-      var len = data.byteLength;
-      var WAM = this.WAM;
-      var buf = WAM._malloc(data.byteLength);
-      for (var i=0; i<len; i++)
-        WAM.setValue(buf+i, buffer[i], 'i8');
-      this.wam_onmessageA(this.inst, verb, prop, buf, len);
-      WAM._free(buf);
+      var buf = this.toArena(data);
+      this.wam_onmessageA(this.inst, verb, prop, buf, data.byteLength);
     }
     else if (typeof data === "string")
       this.wam_onmessageS(this.inst, verb, prop, data);
@@ -130,27 +153,87 @@ class WAMProcessor extends AudioWorkletProcessor
   }
   
   onpatch (data) {
-    var buffer = new Uint8Array(data);
-    var len = data.byteLength;
-    var WAM = this.WAM;
-    var buf = WAM._malloc(len);
-    for (var i=0; i<len; i++)
-      WAM.setValue(buf+i, buffer[i], 'i8');
-    this.wam_onpatch(this.inst, buf, len);
-    WAM._free(buf);
+    var buf = this.toArena(data);
+    this.wam_onpatch(this.inst, buf, data.byteLength);
   }
 
   onsysex (data) {
-    var WAM = this.WAM;
-    var buf = WAM._malloc(data.length);
-    for (var i = 0; i < data.length; i++)
-      WAM.setValue(buf+i, data[i], 'i8');
+    var buf = this.toArena(data);
     this.wam_onsysex(this.inst, buf, data.length);
-    WAM._free(buf);
+  }
+
+  onring (sab) {
+    var HEADER_BYTES = 8;
+    this.ring = {
+      indices: new Int32Array(sab, 0, 2),
+      view: new DataView(sab, HEADER_BYTES),
+      bytes: new Uint8Array(sab, HEADER_BYTES),
+      capacity: sab.byteLength - HEADER_BYTES
+    };
+  }
+
+  // delivers the events due in this render quantum, at their sample offset into it.
+  // an event for a later quantum stops the drain, and is delivered when its quantum comes
+  drainRing () {
+    var ring = this.ring;
+    var write = Atomics.load(ring.indices, 0);
+    var read  = Atomics.load(ring.indices, 1);
+    var now = typeof currentTime !== "undefined" ? currentTime : 0; // the polyfill has no clock, so events are delivered as they come
+
+    while (read != write) {
+      var type = ring.view.getUint32(read, true);
+      if (type == 0) { read = 0; continue; } // wrap
+
+      var size = ring.view.getUint32(read + 4, true);
+      var time = ring.view.getFloat64(read + 8, true);
+      var offset = time > 0 && now > 0 ? Math.round((time - now) * this.sr) : 0;
+      if (offset >= this.bufsize) break;
+      if (offset < 0) offset = 0; // late, as soon as possible
+
+      var i = read + 16;
+      switch (type) {
+        case 1: // midi
+          var status = ring.view.getUint8(i), data1 = ring.view.getUint8(i + 1), data2 = ring.view.getUint8(i + 2);
+          if (this.wam_onmidiAt) this.wam_onmidiAt(this.inst, status, data1, data2, offset);
+          else this.onmidi(status, data1, data2);
+          break;
+        case 2: // param
+          this.onparam(ring.view.getInt32(i + 8, true), ring.view.getFloat64(i, true));
+          break;
+        case 3: // patch
+          this.wam_onpatch(this.inst, this.toArena(ring.bytes.subarray(i, i + size)), size);
+          break;
+        case 4: // sysex
+          this.wam_onsysex(this.inst, this.toArena(ring.bytes.subarray(i, i + size)), size);
+          break;
+      }
+
+      read = (read + ((16 + size + 15) & ~15)) % ring.capacity;
+    }
+
+    Atomics.store(ring.indices, 1, read);
+  }
+
+  // releases the instance and the WASM memory this processor allocated. process() stops rendering after this
+  onterminate () {
+    if (!this.inst) return;
+    var WAM = this.WAM;
+    this.wam_terminate(this.inst);
+    this.inst = 0;
+    WAM._free(this.arena);
+    this.arena = 0;
+    this.arenaSize = 0;
+    this.ring = null;
   }
 
   process (inputs,outputs,params) {
     var WAM = this.WAM;
+
+    if (!this.inst)
+      return false;
+
+    if (this.ring)
+      this.drainRing();
     
     // -- inputs
     for (var i=0; i<this.numInputs; i++) {
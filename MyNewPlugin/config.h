@@ -22,13 +22,16 @@
 #define PLUG_DOES_MIDI_IN 1
 #define PLUG_DOES_MIDI_OUT 0
 #define PLUG_DOES_MPE 0
-#define PLUG_DOES_STATE_CHUNKS 0
+#define PLUG_DOES_STATE_CHUNKS 1
 #define PLUG_HAS_UI 1
 #define PLUG_WIDTH 980
 #define PLUG_HEIGHT 600
 #define PLUG_FPS 60
 #define PLUG_SHARED_RESOURCES 0
 #define PLUG_HOST_RESIZE 0
+#define PLUG_PROFILE_EDITOR_FRAMES 0 // > 0 to time every control's drawing over this many frames at 1x and 2x when the editor opens, printed and written to the temp folder, in any build. The standalone app needs no host
+#define PLUG_CACHE_SVG_CONTROLS 1 // 0 to draw the SVG sliders and knob with iPlug2's own controls, to compare the two with PLUG_PROFILE_EDITOR_FRAMES
+#define PLUG_BLACKBOX_RECORDING 0 // 1 to keep a recording of the last few seconds in each instance (about 1.8 MB each), dumped after a dropout
 
 #define AUV2_ENTRY MyNewPlugin_Entry
 #define AUV2_ENTRY_STR "MyNewPlugin_Entry"
@@ -58,3 +61,8 @@
 #define BEFACO_SLIDEPOT_FN "BefacoSlidePot.svg"
 #define BEFACO_SLIDEPOTHANDLE_FN "BefacoSlidePotHandle.svg"
 #define BEFACO_SLIDEPOTHANDLE_FN "BefacoSlidePotHandle.svg"
+
+// built by scripts/make_resource_atlas.py into the bundle's resources on macOS and iOS builds only (from prepare_resources-*.py). Windows builds,
+// which compile resources into the binary, and web builds, which preload them, don't have it and load resources one file at a time.
+// It only saves finding and reading each file: the SVGs in it are raw text, parsed when the editor opens like any others
+#define RESOURCE_ATLAS_FN "MyNewPlugin-resources.mnra"
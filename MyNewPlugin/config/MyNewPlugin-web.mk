@@ -12,7 +12,17 @@ WAM_SRC += $(PROJECT_ROOT)/MidiSynth.cpp
 
 WEB_CFLAGS += -DIGRAPHICS_NANOVG -DIGRAPHICS_GLES2
 
-WAM_LDFLAGS += -O0 -s EXPORT_NAME="'AudioWorkletGlobalScope.WAM.MyNewPlugin'" -s ASSERTIONS=0
+WAM_LDFLAGS += -s EXPORT_NAME="'AudioWorkletGlobalScope.WAM.MyNewPlugin'" -s ASSERTIONS=0
+
+# WAM_RELEASE=1 builds the WAM processor optimized, with link time optimization and WASM SIMD, so that the voice loops can be vectorized
+# e.g. WAM_RELEASE=1 ./makedist-web.sh off
+# compare the two builds with scripts/benchmark-wam.js
+ifeq ($(WAM_RELEASE),1)
+WAM_CFLAGS += -O3 -flto -msimd128 -DNDEBUG
+WAM_LDFLAGS += -O3 -flto -msimd128
+else
+WAM_LDFLAGS += -O0
+endif
 
 WEB_LDFLAGS += -O0 -s ASSERTIONS=0
 
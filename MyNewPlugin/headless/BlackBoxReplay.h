@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "BlackBoxRecorder.h"
+#include "MySynthEngine.h"
+#include "WavFile.h"
+
+/** Feeds a black box recording through an offline engine, reproducing the plug-in's exact sequence of resets, MIDI, settings changes and block sizes.
+ *  Notes that started before the recording did are not in it, so they won't sound. The engine's setup is keyframed once a second, so anything
+ *  else the replay has to assume is only until the first keyframe
+ * @param pWavFile If not \c nullptr and open, the replay is written to it
+ * @return \c false if the file could not be read */
+static bool RunBlackBoxReplay(const char* path, double defaultSampleRate, int nVoices, WavFileWriter* pWavFile)
+{
+  std::vector<BlackBoxRecorder::Event> events;
+
+  if (!BlackBoxRecorder::Read(path, events))
+    return false;
+
+  MySynthEngine engine(nVoices);
+  std::vector<sample> buffer;
+  double sampleRate = defaultSampleRate;
+  int blockSize = 512;
+  int64_t nBlocks = 0, nFrames = 0, nNoteOns = 0, nLateBlocks = 0;
+  double maxMicros = 0.;
+
+  // if the recording starts after the last reset, the engine still needs one. The keyframe within the first second of the recording says what it was
+  const auto firstReset = std::find_if(events.begin(), events.end(), [](const BlackBoxRecorder::Event& e) { return e.mType == BlackBoxRecorder::kEventReset; });
+  const auto firstBlock = std::find_if(events.begin(), events.end(), [](const BlackBoxRecorder::Event& e) { return e.mType == BlackBoxRecorder::kEventBlock; });
+
+  if (firstReset != events.end())
+  {
+    sampleRate = firstReset->mValues[0];
+    blockSize = (int) firstReset->mData;
+  }
+  else if (firstBlock != events.end())
+    blockSize = (int) firstBlock->mData;
+
+  bool reported = false;
+
+  if (firstReset == events.end() || firstReset > firstBlock)
+  {
+    engine.SetSampleRateAndBlockSize(sampleRate, blockSize);
+    printf("%12s sample rate %g Hz, block size %d\n", "start", sampleRate, blockSize);
+    reported = true;
+  }
+
+  for (const auto& e : events)
+  {
+    switch (e.mType)
+    {
+      case BlackBoxRecorder::kEventReset:
+        // keyframes repeat the current values, only a change is worth reporting
+        if (e.mValues[0] != sampleRate || (int) e.mData != blockSize || !reported)
+          printf("%12lld sample rate %g Hz, block size %u\n", (long long) e.mSampleTime, e.mValues[0], e.mData);
+
+        reported = true;
+        sampleRate = e.mValues[0];
+        blockSize = (int) e.mData;
+        engine.SetSampleRateAndBlockSize(sampleRate, blockSize);
+        break;
+      case BlackBoxRecorder::kEventHardReset:
+        engine.Reset();
+        printf("%12lld hard reset\n", (long long) e.mSampleTime);
+        break;
+      case BlackBoxRecorder::kEventRetriggerMode:
+        engine.SetRetriggerMode(static_cast<MySynthVoice::ERetriggerMode>(e.mData));
+        break;
+      case BlackBoxRecorder::kEventMidi:
+      {
+        const IMidiMsg msg((int) e.mValues[0], (uint8_t) (e.mData >> 16), (uint8_t) (e.mData >> 8), (uint8_t) e.mData);
+        nNoteOns += msg.StatusMsg() == IMidiMsg::kNoteOn && msg.Velocity() > 0;
+        engine.ProcessMidiMsg(msg);
+        break;
+      }
+      case BlackBoxRecorder::kEventSettings:
+      {
+        MySynthVoiceSettings settings;
+        settings.mAttackMs = e.mValues[0];
+        settings.mDecayMs = e.mValues[1];
+        settings.mSustainLevel = e.mValues[2];
+        settings.mReleaseMs = e.mValues[3];
+        engine.ApplyVoiceSettings(settings, (int) e.mData);
+        break;
+      }
+      case BlackBoxRecorder::kEventBlock:
+      {
+        const int blockFrames = (int) e.mData;
+        buffer.resize(std::max(buffer.size(), (size_t) blockFrames));
+        sample* pBlock = buffer.data();
+        engine.ProcessBlock(&pBlock, blockFrames);
+
+        if (pWavFile && pWavFile->IsOpen())
+          pWavFile->Write(&pBlock, blockFrames);
+
+        const double budget = 1e6 * blockFrames / sampleRate;
+
+        if (e.mValues[0] > budget)
+        {
+          printf("%12lld block of %d frames took %.0f us in the plug-in, over its %.0f us budget\n", (long long) e.mSampleTime, blockFrames, e.mValues[0], budget);
+          nLateBlocks++;
+        }
+
+        maxMicros = std::max(maxMicros, e.mValues[0]);
+        nBlocks++;
+        nFrames += blockFrames;
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  int nBusy = 0;
+
+  for (auto* pVoice : engine.mVoices)
+    nBusy += pVoice->GetBusy();
+
+  printf("replayed %lld blocks (%.2f s), %lld note-ons; slowest recorded block %.0f us, %lld over budget; %d voices still sounding at the end\n",
+         (long long) nBlocks, nFrames / sampleRate, (long long) nNoteOns, maxMicros, (long long) nLateBlocks, nBusy);
+  fflush(stdout);
+
+  return true;
+}
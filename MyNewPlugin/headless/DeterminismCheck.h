@@ -0,0 +1,100 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "MySynthEngine.h"
+#include "MidiFile.h"
+
+/** A fixed, irregularly timed note pattern, for when no MIDI file is given. Note times deliberately fall between slice boundaries */
+static std::vector<TimedMidiMsg> MakeDeterminismTestPattern(int64_t& nFrames)
+{
+  std::vector<TimedMidiMsg> events;
+
+  for (int i = 0; i < 48; i++)
+  {
+    const int64_t start = i * 3119;
+    const uint8_t key = (uint8_t) (48 + (i * 7) % 36);
+    events.push_back({start, 0x90, key, (uint8_t) (40 + (i * 13) % 87)});
+    events.push_back({start + 7001, 0x80, key, 0});
+  }
+
+  std::stable_sort(events.begin(), events.end(), [](const TimedMidiMsg& a, const TimedMidiMsg& b) { return a.mSampleTime < b.mSampleTime; });
+  nFrames = events.back().mSampleTime + 44100;
+  return events;
+}
+
+/** Render events offline in deterministic mode */
+static std::vector<sample> RenderDeterministic(const std::vector<TimedMidiMsg>& events, const MySynthVoiceSettings& settings, double sampleRate,
+                                               int blockSize, int64_t nFrames, int nVoices)
+{
+  MySynthEngine engine(nVoices);
+  engine.SetDeterministic(true);
+  engine.SetSampleRateAndBlockSize(sampleRate, blockSize);
+  engine.ApplyVoiceSettings(settings, 0);
+
+  std::vector<sample> output((size_t) nFrames);
+  size_t nextEvent = 0;
+
+  for (int64_t pos = 0; pos < nFrames; pos += blockSize)
+  {
+    const int nBlockFrames = (int) std::min<int64_t>(blockSize, nFrames - pos);
+
+    for (; nextEvent < events.size() && events[nextEvent].mSampleTime < pos + nBlockFrames; nextEvent++)
+    {
+      const TimedMidiMsg& e = events[nextEvent];
+      engine.ProcessMidiMsg(IMidiMsg((int) std::max<int64_t>(e.mSampleTime - pos, 0), e.mStatus, e.mData1, e.mData2));
+    }
+
+    sample* pBlock = output.data() + pos;
+    engine.ProcessBlock(&pBlock, nBlockFrames);
+  }
+
+  return output;
+}
+
+/** Renders the same events in deterministic mode at each block size, and compares every render bit for bit with the first
+ * @return The number of renders that differ */
+static int RunDeterminismCheck(const std::vector<int>& blockSizes, std::vector<TimedMidiMsg> events, const MySynthVoiceSettings& settings,
+                               double sampleRate, int64_t nFrames, int nVoices)
+{
+  if (events.empty())
+    events = MakeDeterminismTestPattern(nFrames);
+
+  std::vector<sample> reference;
+  int nMismatches = 0;
+
+  for (int blockSize : blockSizes)
+  {
+    const std::vector<sample> output = RenderDeterministic(events, settings, sampleRate, blockSize, nFrames, nVoices);
+
+    if (reference.empty())
+    {
+      reference = output;
+      printf("block size %4d reference\n", blockSize);
+      continue;
+    }
+
+    const auto mismatch = std::mismatch(output.begin(), output.end(), reference.begin(),
+                                        [](sample a, sample b) { return std::memcmp(&a, &b, sizeof(sample)) == 0; });
+
+    if (mismatch.first == output.end())
+      printf("block size %4d identical\n", blockSize);
+    else
+    {
+      double maxDiff = 0.;
+
+      for (size_t s = 0; s < output.size(); s++)
+        maxDiff = std::max(maxDiff, (double) std::fabs(output[s] - reference[s]));
+
+      printf("block size %4d DIFFERS from sample %lld, max difference %g\n", blockSize, (long long) (mismatch.first - output.begin()), maxDiff);
+      nMismatches++;
+    }
+  }
+
+  fflush(stdout);
+  return nMismatches;
+}
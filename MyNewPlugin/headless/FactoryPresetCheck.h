@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+
+#include "MySynthEngine.h"
+#include "PluginState.h"
+
+/** Reads a chunk back with ReadState(), as MyNewPlugin::UnserializeState() does, and checks it gives nValues parameter values equal to pValues
+ * @return true if it does */
+static bool CheckStateValues(const char* name, const iplug::IByteChunk& chunk, bool headerless, int nValues, const double* pValues)
+{
+  PluginState state;
+  const int endPos = ReadState(chunk, 0, state);
+  bool passed = endPos == chunk.Size() && state.mHeaderless == headerless && state.mNValues == nValues;
+
+  for (int i = 0; i < nValues && i < kNumParams; i++)
+  {
+    if (state.mValues[i] != pValues[i])
+    {
+      printf("%-12s parameter %d restored as %g, not %g\n", name, i, state.mValues[i], pValues[i]);
+      passed = false;
+    }
+  }
+
+  printf("%-12s %d of %d values %s\n", name, state.mNValues, kNumParams, passed ? "ok" : "FAILED");
+  return passed;
+}
+
+/** Checks that every factory preset's chunk restores every parameter, that Pluck's restored Retrigger value puts the engine in Reset mode, that
+ * state saved before Morph and Retrigger existed still restores the parameters it has, and that a saved state reads back as it was written
+ * @return The number of checks that fail */
+static int RunFactoryPresetCheck(int nVoices)
+{
+  int nFailures = 0;
+
+  for (const FactoryPreset& preset : kFactoryPresets)
+  {
+    iplug::IByteChunk chunk;
+    MakeFactoryPresetChunk(preset, chunk);
+    nFailures += !CheckStateValues(preset.mName, chunk, true, kNumParams, preset.mValues);
+  }
+
+  const FactoryPreset& pluck = kFactoryPresets[1];
+  iplug::IByteChunk pluckChunk;
+  MakeFactoryPresetChunk(pluck, pluckChunk);
+  PluginState pluckState;
+  ReadState(pluckChunk, 0, pluckState);
+
+  MySynthEngine engine(nVoices);
+  engine.SetRetriggerMode(MySynthVoice::RetriggerModeFromValue(pluckState.mValues[kParamRetrigger]));
+  const bool pluckResets = engine.GetRetriggerMode() == MySynthVoice::kRetriggerPhaseReset;
+  printf("%-12s retrigger mode %s\n", pluck.mName, pluckResets ? "ok" : "FAILED");
+  nFailures += !pluckResets;
+
+  iplug::IByteChunk oldChunk;
+  oldChunk.PutBytes(pluck.mValues, kParamMorph * sizeof(double));
+  nFailures += !CheckStateValues("old session", oldChunk, true, kParamMorph, pluck.mValues);
+
+  PluginState saved;
+  saved.mNValues = kNumParams;
+  std::copy_n(pluck.mValues, kNumParams, saved.mValues);
+  saved.mVelocityLUT[64] = 100;
+  saved.mTuning = -0.5;
+  saved.mMorphActive = true;
+  saved.mMorphValues[2 * kNumParams - 1] = 1.;
+
+  iplug::IByteChunk savedChunk;
+  WriteState(savedChunk, saved);
+  nFailures += !CheckStateValues("saved state", savedChunk, false, kNumParams, saved.mValues);
+
+  PluginState restored;
+  ReadState(savedChunk, 0, restored);
+  const bool restoredRest = restored.mVelocityLUT[64] == 100 && restored.mTuning == -0.5 && restored.mMorphActive &&
+                            restored.mNMorphValues == kNumParams && restored.mMorphValues[2 * kNumParams - 1] == 1.;
+  printf("%-12s curves, tuning and morph %s\n", "saved state", restoredRest ? "ok" : "FAILED");
+  nFailures += !restoredRest;
+
+  fflush(stdout);
+  return nFailures;
+}
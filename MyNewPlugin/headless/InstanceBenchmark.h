@@ -0,0 +1,97 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "MySynthEngine.h"
+#include "PresetEngine.h"
+
+/** What one plug-in instance creates for its DSP: the engine, plus a preset engine and a morph engine. The snapshot types are the plug-in's
+ *  business, so voice settings stand in for them; what costs is the engines' clients of the WorkerPool */
+struct BenchmarkInstance
+{
+  BenchmarkInstance(int nVoices, double sampleRate, int blockSize)
+  : mEngine(nVoices)
+  {
+    mEngine.SetSampleRateAndBlockSize(sampleRate, blockSize);
+  }
+
+  static void PrepareSettings(const double*, int, MySynthVoiceSettings&) {}
+
+  MySynthEngine mEngine;
+  PresetEngine<MySynthVoiceSettings> mPresetEngine {8, PrepareSettings};
+  PresetEngine<MySynthVoiceSettings> mMorphEngine {17, PrepareSettings};
+};
+
+/** @return The process's resident memory in KB, from /proc, or -1 if it can't be read */
+static long ReadResidentKB()
+{
+  long kb = -1;
+
+  if (FILE* pFile = fopen("/proc/self/status", "r"))
+  {
+    char line[256];
+
+    while (fgets(line, sizeof(line), pFile))
+    {
+      if (!strncmp(line, "VmRSS:", 6))
+        kb = atol(line + 6);
+    }
+
+    fclose(pFile);
+  }
+
+  return kb;
+}
+
+/** @return The number of threads in the process, from /proc, or -1 if it can't be read */
+static int ReadThreadCount()
+{
+  int nThreads = -1;
+
+  if (FILE* pFile = fopen("/proc/self/status", "r"))
+  {
+    char line[256];
+
+    while (fgets(line, sizeof(line), pFile))
+    {
+      if (!strncmp(line, "Threads:", 8))
+        nThreads = atoi(line + 8);
+    }
+
+    fclose(pFile);
+  }
+
+  return nThreads;
+}
+
+/** Creates nInstances of what a plug-in instance creates for its DSP, as a host loading a template with one instance per track would,
+ *  and reports the time and resident memory each one costs and how many threads the process ends up with.
+ *  Then enables every instance's black box recorder, as a build with PLUG_BLACKBOX_RECORDING does, and reports what that adds */
+static void RunInstanceBenchmark(int nInstances, int nVoices, double sampleRate, int blockSize)
+{
+  std::vector<std::unique_ptr<BenchmarkInstance>> instances;
+  instances.reserve(nInstances);
+
+  const long startKB = ReadResidentKB();
+  const int startThreads = ReadThreadCount();
+  const auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < nInstances; i++)
+    instances.emplace_back(new BenchmarkInstance(nVoices, sampleRate, blockSize));
+
+  const double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  const long instancesKB = ReadResidentKB();
+
+  printf("%d instances of %d voices: %.1f us and %.1f KB resident each, %d threads started\n", nInstances, nVoices, micros / nInstances,
+         (double) (instancesKB - startKB) / nInstances, ReadThreadCount() - startThreads);
+
+  for (auto& instance : instances)
+    instance->mEngine.mRecorder.SetEnabled(true);
+
+  printf("black box recording enabled: %.1f KB more resident each\n", (double) (ReadResidentKB() - instancesKB) / nInstances);
+  fflush(stdout);
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/** A channel message at an absolute sample position */
+struct TimedMidiMsg
+{
+  int64_t mSampleTime;
+  uint8_t mStatus;
+  uint8_t mData1;
+  uint8_t mData2;
+};
+
+/** Reads the channel messages of a standard MIDI file (format 0 or 1) into a single list, sorted by time and converted to samples
+ *  using the file's tempo map. Sysex and meta events other than tempo are skipped. SMPTE time division is not supported.
+ * @param path Path to the .mid file
+ * @param sampleRate The sample rate to convert times to
+ * @param events Filled with the file's messages
+ * @return \c true on success */
+static bool ReadMidiFile(const char* path, double sampleRate, std::vector<TimedMidiMsg>& events)
+{
+  FILE* pFile = fopen(path, "rb");
+
+  if (!pFile)
+    return false;
+
+  std::vector<uint8_t> data;
+  uint8_t buf[4096];
+  size_t nRead;
+
+  while ((nRead = fread(buf, 1, sizeof(buf), pFile)) > 0)
+    data.insert(data.end(), buf, buf + nRead);
+
+  fclose(pFile);
+
+  size_t pos = 0;
+
+  auto read32 = [&]() { uint32_t v = 0; for (int i = 0; i < 4 && pos < data.size(); i++) v = (v << 8) | data[pos++]; return v; };
+  auto read16 = [&]() { uint32_t v = 0; for (int i = 0; i < 2 && pos < data.size(); i++) v = (v << 8) | data[pos++]; return v; };
+  auto readVarLen = [&](size_t end) { uint32_t v = 0; uint8_t b; do { if (pos >= end) return v; b = data[pos++]; v = (v << 7) | (b & 0x7F); } while (b & 0x80); return v; };
+
+  if (data.size() < 14 || read32() != 0x4D546864) // "MThd"
+    return false;
+
+  const uint32_t headerLength = read32();
+  read16(); // format
+  const uint32_t nTracks = read16();
+  const uint32_t division = read16();
+  pos = 8 + headerLength;
+
+  if (division & 0x8000 || division == 0)
+    return false;
+
+  struct TickEvent
+  {
+    uint64_t mTick;
+    uint32_t mOrder; // keeps events at the same tick in file order
+    uint8_t mStatus, mData1, mData2;
+    uint32_t mTempo; // for tempo events (mStatus == 0xFF), microseconds per quarter note
+  };
+
+  std::vector<TickEvent> tickEvents;
+  uint32_t order = 0;
+
+  for (uint32_t t = 0; t < nTracks && pos + 8 <= data.size(); t++)
+  {
+    const uint32_t chunkType = read32();
+    const uint32_t chunkLength = read32();
+    const size_t end = std::min(pos + (size_t) chunkLength, data.size());
+
+    if (chunkType != 0x4D54726B) // "MTrk"
+    {
+      pos = end;
+      continue;
+    }
+
+    uint64_t tick = 0;
+    uint8_t runningStatus = 0;
+
+    while (pos < end)
+    {
+      tick += readVarLen(end);
+
+      if (pos >= end)
+        break;
+
+      uint8_t status = data[pos];
+
+      if (status & 0x80)
+        pos++;
+      else if (runningStatus)
+        status = runningStatus;
+      else
+        return false;
+
+      if (status == 0xFF) // meta event
+      {
+        const uint8_t type = pos < end ? data[pos++] : 0;
+        const uint32_t length = readVarLen(end);
+
+        if (type == 0x51 && length == 3 && pos + 3 <= end)
+          tickEvents.push_back({tick, order++, 0xFF, 0, 0, (uint32_t) (data[pos] << 16 | data[pos + 1] << 8 | data[pos + 2])});
+
+        pos += length;
+      }
+      else if (status == 0xF0 || status == 0xF7) // sysex
+      {
+        pos += readVarLen(end);
+      }
+      else
+      {
+        runningStatus = status;
+        const int nDataBytes = ((status & 0xF0) == 0xC0 || (status & 0xF0) == 0xD0) ? 1 : 2;
+        const uint8_t data1 = pos < end ? data[pos++] : 0;
+        const uint8_t data2 = (nDataBytes == 2 && pos < end) ? data[pos++] : 0;
+        tickEvents.push_back({tick, order++, status, data1, data2, 0});
+      }
+    }
+
+    pos = end;
+  }
+
+  std::stable_sort(tickEvents.begin(), tickEvents.end(), [](const TickEvent& a, const TickEvent& b) {
+    return a.mTick < b.mTick || (a.mTick == b.mTick && a.mOrder < b.mOrder);
+  });
+
+  // walk the merged list, converting ticks to seconds with the tempo in force at each point
+  double tempo = 500000.; // microseconds per quarter note, i.e. 120 bpm
+  double seconds = 0.;
+  uint64_t lastTick = 0;
+
+  events.clear();
+
+  for (const auto& e : tickEvents)
+  {
+    seconds += (double) (e.mTick - lastTick) * tempo / (1000000. * division);
+    lastTick = e.mTick;
+
+    if (e.mStatus == 0xFF)
+      tempo = e.mTempo;
+    else
+      events.push_back({(int64_t) (seconds * sampleRate + 0.5), e.mStatus, e.mData1, e.mData2});
+  }
+
+  return true;
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MySynthEngine.h"
+#include "WavFile.h"
+
+/** Options for bouncing every key x velocity layer x round robin of the current patch to a sample library */
+struct ExportOptions
+{
+  std::string mDir; // empty means no export
+  int mLowKey = 36;
+  int mHighKey = 96;
+  int mKeyStep = 1; // sample every nth key, each sample is mapped across the keys up to the next one
+  std::vector<int> mVelocities = {127};
+  int mRoundRobins = 1; // each round robin starts the oscillator at a different phase
+  double mHoldSeconds = 1.;
+  double mSilenceDb = -90.; // a note has ended once its output stays below this level
+  double mMaxSeconds = 30.; // hard limit on a note's length, including its release
+  int mNThreads = 0; // 0 means one per core
+};
+
+/** Renders the notes described by ExportOptions in isolated engines, one per worker thread and round robin, across all cores.
+ *  Each note is held for mHoldSeconds, then rendered until it has been below mSilenceDb for a while (or the voices have finished),
+ *  trimmed after the last sample above the threshold, and written to its own mono WAV. An SFZ file maps the samples.
+ * @return The number of notes that could not be written */
+static int RunMultisampleExport(const ExportOptions& options, const MySynthVoiceSettings& settings, double sampleRate, int blockSize, int nVoices)
+{
+  struct Note
+  {
+    int mKey;
+    int mVelocity;
+    int mRoundRobin;
+    std::string mFileName;
+    bool mWritten = false;
+    int64_t mLength = 0;
+  };
+
+  std::vector<int> velocities = options.mVelocities;
+  std::sort(velocities.begin(), velocities.end());
+
+  std::vector<Note> notes;
+
+  for (int key = options.mLowKey; key <= options.mHighKey; key += options.mKeyStep)
+    for (int velocity : velocities)
+      for (int rr = 0; rr < options.mRoundRobins; rr++)
+      {
+        char fileName[64];
+        snprintf(fileName, sizeof(fileName), "MyNewPlugin_%03d_v%03d_rr%d.wav", key, velocity, rr + 1);
+        notes.push_back({key, velocity, rr, fileName});
+      }
+
+  const int nThreads = std::max(1, options.mNThreads ? options.mNThreads : (int) std::thread::hardware_concurrency());
+  const double threshold = std::pow(10., options.mSilenceDb / 20.);
+  const int64_t holdFrames = (int64_t) (options.mHoldSeconds * sampleRate);
+  const int64_t maxFrames = std::max(holdFrames, (int64_t) (options.mMaxSeconds * sampleRate));
+  const int64_t silenceWindow = (int64_t) (0.05 * sampleRate); // how long the output must stay quiet before a note counts as over
+
+  std::atomic<size_t> nextNote {0};
+
+  auto worker = [&]() {
+    // engines are created per round robin on first use and kept, so each thread's notes share nothing with any other thread's
+    std::vector<std::unique_ptr<MySynthEngine>> engines(options.mRoundRobins);
+    std::vector<sample> buffer;
+    WavFileWriter wavFile;
+
+    for (size_t n; (n = nextNote.fetch_add(1)) < notes.size();)
+    {
+      Note& note = notes[n];
+      auto& pEngine = engines[note.mRoundRobin];
+
+      if (!pEngine)
+      {
+        pEngine.reset(new MySynthEngine(nVoices, (double) note.mRoundRobin / options.mRoundRobins));
+        pEngine->SetDeterministic(true);
+        pEngine->SetSampleRateAndBlockSize(sampleRate, blockSize);
+        pEngine->ApplyVoiceSettings(settings, 0);
+      }
+
+      pEngine->Reset();
+
+      IMidiMsg msg;
+      msg.MakeNoteOnMsg(note.mKey, note.mVelocity, 0);
+      pEngine->ProcessMidiMsg(msg);
+
+      buffer.clear();
+      int64_t lastLoud = 0; // one past the last sample above the threshold
+      bool released = false;
+
+      for (int64_t pos = 0; pos < maxFrames; pos += blockSize)
+      {
+        const int nFrames = (int) std::min<int64_t>(blockSize, maxFrames - pos);
+
+        if (!released && pos + nFrames > holdFrames)
+        {
+          msg.MakeNoteOffMsg(note.mKey, (int) (holdFrames - pos));
+          pEngine->ProcessMidiMsg(msg);
+          released = true;
+        }
+
+        buffer.resize((size_t) (pos + nFrames));
+        sample* pBlock = buffer.data() + pos;
+        const bool silent = pEngine->ProcessBlock(&pBlock, nFrames);
+
+        for (int s = 0; s < nFrames; s++)
+          if (std::fabs(pBlock[s]) > threshold)
+            lastLoud = pos + s + 1;
+
+        if (released && (silent || pos + nFrames - lastLoud >= silenceWindow))
+          break;
+      }
+
+      note.mLength = std::max<int64_t>(lastLoud, 1);
+
+      if (wavFile.Open((options.mDir + "/" + note.mFileName).c_str(), 1, sampleRate))
+      {
+        sample* pData = buffer.data();
+        wavFile.Write(&pData, (int) note.mLength);
+        wavFile.Close();
+        note.mWritten = true;
+      }
+    }
+  };
+
+  const auto startTime = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> threads;
+
+  for (int t = 0; t < nThreads; t++)
+    threads.emplace_back(worker);
+
+  for (auto& thread : threads)
+    thread.join();
+
+  const double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+  // the mapping: each sample covers the keys up to the next sampled key, and the velocities down to the layer below
+  const std::string sfzPath = options.mDir + "/MyNewPlugin.sfz";
+  FILE* pSfz = fopen(sfzPath.c_str(), "w");
+  int nFailed = 0;
+  int64_t totalFrames = 0;
+
+  if (pSfz)
+    fprintf(pSfz, "// generated by MyNewPlugin-headless --export\n<control>\ndefault_path=./\n\n<global>\nseq_length=%d\n\n", options.mRoundRobins);
+
+  for (const Note& note : notes)
+  {
+    totalFrames += note.mLength;
+
+    if (!note.mWritten)
+    {
+      fprintf(stderr, "could not write %s\n", note.mFileName.c_str());
+      nFailed++;
+      continue;
+    }
+
+    if (!pSfz)
+      continue;
+
+    const auto layer = std::find(velocities.begin(), velocities.end(), note.mVelocity);
+    const int lowVelocity = layer == velocities.begin() ? 1 : *(layer - 1) + 1;
+    const int highKey = std::min(note.mKey + options.mKeyStep - 1, options.mHighKey);
+
+    fprintf(pSfz, "<region> sample=%s pitch_keycenter=%d lokey=%d hikey=%d lovel=%d hivel=%d seq_position=%d\n",
+            note.mFileName.c_str(), note.mKey, note.mKey, highKey, lowVelocity, note.mVelocity, note.mRoundRobin + 1);
+  }
+
+  if (pSfz)
+    fclose(pSfz);
+  else
+  {
+    fprintf(stderr, "could not write %s\n", sfzPath.c_str());
+    nFailed++;
+  }
+
+  printf("exported %d notes (%.1f s of audio) in %.2f s on %d threads: %.1f notes/s\n",
+         (int) notes.size() - nFailed, totalFrames / sampleRate, wallSeconds, nThreads, wallSeconds > 0. ? notes.size() / wallSeconds : 0.);
+
+  return nFailed;
+}
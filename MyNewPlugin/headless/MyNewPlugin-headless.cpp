@@ -0,0 +1,548 @@
+/*
+ Headless runner for MyNewPlugin's DSP, for long unattended load tests on build machines.
+
+ Renders MySynthEngine (the same code the plug-in runs, without the editor or any plug-in API) through a null or
+ file-backed "audio driver", either free-running or paced by a simulated realtime clock, with MIDI from a standard
+ MIDI file and/or raw MIDI bytes sent to a UDP port on localhost.
+
+ Scope: this is the engine, not the MyNewPlugin class. A load test covers everything the plug-in does to render MIDI
+ (MIDI queueing and slicing, voice allocation, oscillators, envelopes, voice settings changes, the black box recorder),
+ but not what MyNewPlugin::ProcessBlock() does around it: picking up preset and morph snapshots from the PresetEngines,
+ routing host parameter changes, publishing the keyboard state to the editor and copying the left channel to the right,
+ nor applying restored state and the iPlug2 API wrapper (--check-presets covers reading it). Those need iPlug2's IPlugAPIBase, which only the real plug-in targets
+ build. --param and --retrigger set the engine up the way the plug-in's parameters would, once, before the run.
+
+ Examples:
+   MyNewPlugin-headless --midi song.mid --loop --duration 3600 --realtime
+   MyNewPlugin-headless --driver file --out render.wav --midi song.mid --block 128 --param release=250
+   MyNewPlugin-headless --udp 9000 --realtime
+
+ With --export it instead bounces every key x velocity layer x round robin of the patch to per-note WAV files plus an SFZ mapping:
+   MyNewPlugin-headless --export out/ --keys 21-108 --key-step 3 --velocities 40,80,127 --round-robins 2 --param release=400
+
+ With --compare-block-sizes it renders the MIDI file (or a built-in pattern) in deterministic mode at each block size,
+ and exits with status 3 unless every render is bit-identical:
+   MyNewPlugin-headless --compare-block-sizes 32,64,512,97 --midi song.mid
+
+ With --check-note-timing it plays notes that start and end inside one slice, and exits with status 4 if any of them gets stuck or sounds early:
+   MyNewPlugin-headless --check-note-timing --param release=50
+
+ With --check-preset-change it changes the voice settings during each stage of a note, with the plug-in's 20 ms preset crossfade, and exits
+ with status 5 if the envelope steps or changes speed abruptly:
+   MyNewPlugin-headless --check-preset-change
+
+ With --check-presets it restores each factory preset, an old session and a saved state the way the plug-in reads state chunks, and exits
+ with status 6 if any parameter doesn't come back as it was:
+   MyNewPlugin-headless --check-presets
+
+ With --instances it creates that many copies of what a plug-in instance creates for its DSP, and reports the time, memory and threads they cost:
+   MyNewPlugin-headless --instances 100
+
+ With --replay it feeds a black box recording (dumped by the plug-in after a dropout, or by --record) through the engine block by block:
+   MyNewPlugin-headless --replay /tmp/MyNewPlugin-blackbox-1700000000.mnbb --driver file --out replay.wav
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MySynthEngine.h"
+#include "BlackBoxReplay.h"
+#include "DeterminismCheck.h"
+#include "FactoryPresetCheck.h"
+#include "InstanceBenchmark.h"
+#include "MidiFile.h"
+#include "MultisampleExport.h"
+#include "NoteTimingCheck.h"
+#include "PresetChangeCheck.h"
+#include "WavFile.h"
+
+using namespace iplug;
+
+static constexpr int kNumVoices = 32; // as in the plug-in
+static constexpr double kPresetCrossfadeMs = 20.; // as in the plug-in
+static constexpr int kNumOutputs = 2;
+static constexpr double kReportIntervalSeconds = 10.;
+
+static std::atomic<bool> sQuit {false};
+
+struct Options
+{
+  bool mFileDriver = false;
+  std::string mOutPath = "MyNewPlugin-headless.wav";
+  double mSampleRate = 44100.;
+  int mBlockSize = 64; // APP_SIGNAL_VECTOR_SIZE
+  bool mRealtime = false;
+  bool mDeterministic = false;
+  std::vector<int> mCompareBlockSizes;
+  bool mCheckNoteTiming = false;
+  bool mCheckPresetChange = false;
+  bool mCheckPresets = false;
+  int mNInstances = 0;
+  std::string mRecordPath;
+  std::string mReplayPath;
+  double mDuration = -1.; // seconds, < 0 means until the MIDI file has finished, or forever when listening on a socket
+  double mTail = 2.; // seconds rendered after the last MIDI event
+  std::string mMidiPath;
+  bool mLoop = false;
+  int mUdpPort = 0;
+  MySynthVoiceSettings mVoiceSettings;
+  MySynthVoice::ERetriggerMode mRetriggerMode = MySynthVoice::kRetriggerLegato;
+  ExportOptions mExport;
+};
+
+static void PrintUsage()
+{
+  printf("usage: MyNewPlugin-headless [options]\n"
+         "  --driver null|file    audio backend (default null)\n"
+         "  --out PATH            output .wav for the file driver\n"
+         "  --sr HZ               sample rate (default 44100)\n"
+         "  --block N             block size (default 64)\n"
+         "  --realtime            pace blocks with a simulated realtime clock, reporting missed deadlines (default: free-running)\n"
+         "  --duration SECONDS    stop after this much audio\n"
+         "  --tail SECONDS        audio rendered after the last MIDI event (default 2)\n"
+         "  --midi PATH           play a standard MIDI file\n"
+         "  --loop                loop the MIDI file\n"
+         "  --udp PORT            accept raw MIDI bytes on a localhost UDP port\n"
+         "  --param NAME=VALUE    attack, decay or release in ms, sustain in %%\n"
+         "  --retrigger MODE      legato, reset or free: how a sounding voice restarts when its key is struck again (default legato)\n"
+         "  --deterministic       output that doesn't depend on block size or thread count\n"
+         "  --compare-block-sizes A,B,...  render deterministically at each block size and check the results are identical\n"
+         "  --check-note-timing   check that notes starting and ending inside one slice neither stick nor sound early\n"
+         "  --check-preset-change check that changing the settings during a note crossfades without a step or a sudden change of speed\n"
+         "  --check-presets       check that every factory preset, and saved state, restores every parameter\n"
+         "  --instances N         measure what creating N plug-in instances' DSP costs\n"
+         "  --record PATH         write a black box recording of the run to PATH\n"
+         "  --replay PATH         replay a black box recording instead of playing\n"
+         "multisample export:\n"
+         "  --export DIR          render every note below to DIR, with an SFZ mapping, instead of playing\n"
+         "  --keys LO-HI          key range (default 36-96)\n"
+         "  --key-step N          sample every Nth key (default 1)\n"
+         "  --velocities A,B,...  velocity layers (default 127)\n"
+         "  --round-robins N      round robins per layer (default 1)\n"
+         "  --hold SECONDS        time before note-off (default 1)\n"
+         "  --silence DB          level below which a released note has ended (default -90)\n"
+         "  --max-length SECONDS  longest note, including release (default 30)\n"
+         "  --threads N           worker threads (default: one per core)\n");
+}
+
+static bool SetParam(const char* nameValue, MySynthVoiceSettings& settings)
+{
+  const char* pEquals = strchr(nameValue, '=');
+
+  if (!pEquals)
+    return false;
+
+  const std::string name(nameValue, pEquals - nameValue);
+  const double value = atof(pEquals + 1);
+
+  if (name == "attack") settings.mAttackMs = value;
+  else if (name == "decay") settings.mDecayMs = value;
+  else if (name == "sustain") settings.mSustainLevel = value / 100.;
+  else if (name == "release") settings.mReleaseMs = value;
+  else return false;
+
+  return true;
+}
+
+static bool ParseOptions(int argc, char** argv, Options& options)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+
+    if (arg == "--driver" && hasValue)
+    {
+      const std::string driver = argv[++i];
+
+      if (driver != "null" && driver != "file")
+        return false;
+
+      options.mFileDriver = driver == "file";
+    }
+    else if (arg == "--out" && hasValue) options.mOutPath = argv[++i];
+    else if (arg == "--sr" && hasValue) options.mSampleRate = atof(argv[++i]);
+    else if (arg == "--block" && hasValue) options.mBlockSize = atoi(argv[++i]);
+    else if (arg == "--realtime") options.mRealtime = true;
+    else if (arg == "--deterministic") options.mDeterministic = true;
+    else if (arg == "--check-note-timing") options.mCheckNoteTiming = true;
+    else if (arg == "--check-preset-change") options.mCheckPresetChange = true;
+    else if (arg == "--check-presets") options.mCheckPresets = true;
+    else if (arg == "--instances" && hasValue)
+    {
+      options.mNInstances = atoi(argv[++i]);
+
+      if (options.mNInstances < 1)
+        return false;
+    }
+    else if (arg == "--retrigger" && hasValue)
+    {
+      static const char* modeNames[MySynthVoice::kNumRetriggerModes] = {"legato", "reset", "free"};
+      const auto pName = std::find_if(modeNames, modeNames + MySynthVoice::kNumRetriggerModes, [&](const char* name) { return !strcmp(name, argv[i + 1]); });
+
+      if (pName == modeNames + MySynthVoice::kNumRetriggerModes)
+        return false;
+
+      options.mRetriggerMode = static_cast<MySynthVoice::ERetriggerMode>(pName - modeNames);
+      i++;
+    }
+    else if (arg == "--record" && hasValue) options.mRecordPath = argv[++i];
+    else if (arg == "--replay" && hasValue) options.mReplayPath = argv[++i];
+    else if (arg == "--compare-block-sizes" && hasValue)
+    {
+      for (const char* p = argv[++i]; *p; p += strcspn(p, ","), p += (*p == ','))
+        options.mCompareBlockSizes.push_back(atoi(p));
+
+      if (std::any_of(options.mCompareBlockSizes.begin(), options.mCompareBlockSizes.end(), [](int bs) { return bs < 1; }))
+        return false;
+    }
+    else if (arg == "--duration" && hasValue) options.mDuration = atof(argv[++i]);
+    else if (arg == "--tail" && hasValue) options.mTail = atof(argv[++i]);
+    else if (arg == "--midi" && hasValue) options.mMidiPath = argv[++i];
+    else if (arg == "--loop") options.mLoop = true;
+    else if (arg == "--udp" && hasValue) options.mUdpPort = atoi(argv[++i]);
+    else if (arg == "--param" && hasValue)
+    {
+      if (!SetParam(argv[++i], options.mVoiceSettings))
+        return false;
+    }
+    else if (arg == "--export" && hasValue) options.mExport.mDir = argv[++i];
+    else if (arg == "--keys" && hasValue)
+    {
+      if (sscanf(argv[++i], "%d-%d", &options.mExport.mLowKey, &options.mExport.mHighKey) != 2)
+        return false;
+    }
+    else if (arg == "--key-step" && hasValue) options.mExport.mKeyStep = atoi(argv[++i]);
+    else if (arg == "--velocities" && hasValue)
+    {
+      options.mExport.mVelocities.clear();
+
+      for (const char* p = argv[++i]; *p; p += strcspn(p, ","), p += (*p == ','))
+        options.mExport.mVelocities.push_back(atoi(p));
+    }
+    else if (arg == "--round-robins" && hasValue) options.mExport.mRoundRobins = atoi(argv[++i]);
+    else if (arg == "--hold" && hasValue) options.mExport.mHoldSeconds = atof(argv[++i]);
+    else if (arg == "--silence" && hasValue) options.mExport.mSilenceDb = atof(argv[++i]);
+    else if (arg == "--max-length" && hasValue) options.mExport.mMaxSeconds = atof(argv[++i]);
+    else if (arg == "--threads" && hasValue) options.mExport.mNThreads = atoi(argv[++i]);
+    else
+      return false;
+  }
+
+  const ExportOptions& e = options.mExport;
+  const bool validVelocities = !e.mVelocities.empty() && std::all_of(e.mVelocities.begin(), e.mVelocities.end(), [](int v) { return v > 0 && v < 128; });
+
+  if (!e.mDir.empty() && (e.mLowKey < 0 || e.mHighKey > 127 || e.mLowKey > e.mHighKey || e.mKeyStep < 1 || !validVelocities || e.mRoundRobins < 1 || e.mNThreads < 0))
+    return false;
+
+  return options.mSampleRate > 0. && options.mBlockSize > 0;
+}
+
+/** Receives raw MIDI bytes from a non-blocking UDP socket bound to localhost. A datagram may hold several messages, and running status is honoured */
+class UdpMidiInput
+{
+public:
+  ~UdpMidiInput()
+  {
+    if (mSocket >= 0)
+      close(mSocket);
+  }
+
+  bool Open(int port)
+  {
+    mSocket = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (mSocket < 0)
+      return false;
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t) port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(mSocket, (sockaddr*) &addr, sizeof(addr)) < 0)
+      return false;
+
+    return fcntl(mSocket, F_SETFL, fcntl(mSocket, F_GETFL, 0) | O_NONBLOCK) == 0;
+  }
+
+  /** Passes every message received since the last call to func, at offset 0 */
+  template <typename F>
+  void Poll(F func)
+  {
+    uint8_t buf[1024];
+    ssize_t nBytes;
+
+    while ((nBytes = recv(mSocket, buf, sizeof(buf), 0)) > 0)
+    {
+      for (ssize_t i = 0; i < nBytes; i++)
+      {
+        const uint8_t b = buf[i];
+
+        if (b >= 0xF8) // realtime messages can appear anywhere and are ignored
+          continue;
+
+        if (b & 0x80)
+        {
+          mStatus = b < 0xF0 ? b : 0; // system common messages are ignored, and cancel running status
+          mNData = 0;
+          continue;
+        }
+
+        if (!mStatus)
+          continue;
+
+        mData[mNData++] = b;
+        const int nDataBytes = ((mStatus & 0xF0) == 0xC0 || (mStatus & 0xF0) == 0xD0) ? 1 : 2;
+
+        if (mNData == nDataBytes)
+        {
+          func(IMidiMsg(0, mStatus, mData[0], nDataBytes == 2 ? mData[1] : 0));
+          mNData = 0;
+        }
+      }
+    }
+  }
+
+private:
+  int mSocket = -1;
+  uint8_t mStatus = 0;
+  uint8_t mData[2] = {};
+  int mNData = 0;
+};
+
+struct SoakStats
+{
+  int64_t mNBlocks = 0;
+  int64_t mNMissedDeadlines = 0;
+  int64_t mNNonFinite = 0;
+  double mMaxBlockSeconds = 0.;
+  double mTotalBlockSeconds = 0.;
+  double mPeak = 0.;
+
+  void Print(int64_t nFrames, const Options& options, double wallSeconds) const
+  {
+    const double blockBudget = options.mBlockSize / options.mSampleRate;
+    const double audioSeconds = nFrames / options.mSampleRate;
+
+    printf("%.1f s rendered in %.1f s (%.1fx realtime), %lld blocks, block time avg %.1f us / max %.1f us (budget %.1f us), "
+           "%lld missed deadlines, peak %.3f, %lld non-finite samples\n",
+           audioSeconds, wallSeconds, wallSeconds > 0. ? audioSeconds / wallSeconds : 0., (long long) mNBlocks,
+           mNBlocks ? 1e6 * mTotalBlockSeconds / mNBlocks : 0., 1e6 * mMaxBlockSeconds, 1e6 * blockBudget,
+           (long long) mNMissedDeadlines, mPeak, (long long) mNNonFinite);
+    fflush(stdout);
+  }
+};
+
+int main(int argc, char** argv)
+{
+  Options options;
+
+  if (!ParseOptions(argc, argv, options))
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  if (!options.mExport.mDir.empty())
+  {
+    if (mkdir(options.mExport.mDir.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+      fprintf(stderr, "could not create %s\n", options.mExport.mDir.c_str());
+      return 1;
+    }
+
+    return RunMultisampleExport(options.mExport, options.mVoiceSettings, options.mSampleRate, options.mBlockSize, kNumVoices) ? 1 : 0;
+  }
+
+  if (options.mCheckNoteTiming)
+    return RunNoteTimingCheck(options.mVoiceSettings, options.mSampleRate, options.mBlockSize, kNumVoices) ? 4 : 0;
+
+  if (options.mCheckPresetChange)
+    return RunPresetChangeCheck(options.mSampleRate, kNumVoices, kPresetCrossfadeMs) ? 5 : 0;
+
+  if (options.mCheckPresets)
+    return RunFactoryPresetCheck(kNumVoices) ? 6 : 0;
+
+  if (options.mNInstances)
+  {
+    RunInstanceBenchmark(options.mNInstances, kNumVoices, options.mSampleRate, options.mBlockSize);
+    return 0;
+  }
+
+  WavFileWriter wavFile;
+
+  if (options.mFileDriver && !wavFile.Open(options.mOutPath.c_str(), options.mReplayPath.empty() ? kNumOutputs : 1, options.mSampleRate))
+  {
+    fprintf(stderr, "could not open %s\n", options.mOutPath.c_str());
+    return 1;
+  }
+
+  if (!options.mReplayPath.empty())
+  {
+    if (RunBlackBoxReplay(options.mReplayPath.c_str(), options.mSampleRate, kNumVoices, &wavFile))
+      return 0;
+
+    fprintf(stderr, "could not read black box recording %s\n", options.mReplayPath.c_str());
+    return 1;
+  }
+
+  std::vector<TimedMidiMsg> midiEvents;
+
+  if (!options.mMidiPath.empty() && !ReadMidiFile(options.mMidiPath.c_str(), options.mSampleRate, midiEvents))
+  {
+    fprintf(stderr, "could not read MIDI file %s\n", options.mMidiPath.c_str());
+    return 1;
+  }
+
+  UdpMidiInput udpInput;
+
+  if (options.mUdpPort && !udpInput.Open(options.mUdpPort))
+  {
+    fprintf(stderr, "could not listen on UDP port %d\n", options.mUdpPort);
+    return 1;
+  }
+
+  // one pass of the MIDI file, including its tail
+  const int64_t songFrames = midiEvents.empty() ? 0 : midiEvents.back().mSampleTime + (int64_t) (options.mTail * options.mSampleRate);
+  int64_t totalFrames = -1; // forever
+
+  if (options.mDuration >= 0.)
+    totalFrames = (int64_t) (options.mDuration * options.mSampleRate);
+  else if (!options.mLoop && !options.mUdpPort)
+    totalFrames = songFrames;
+
+  if (!options.mCompareBlockSizes.empty())
+    return RunDeterminismCheck(options.mCompareBlockSizes, midiEvents, options.mVoiceSettings, options.mSampleRate,
+                               totalFrames > 0 ? totalFrames : songFrames, kNumVoices) ? 3 : 0;
+
+  if (totalFrames < 0 && !options.mUdpPort && !(options.mLoop && songFrames > 0))
+  {
+    fprintf(stderr, "nothing to play: give a MIDI file, a UDP port or a duration\n");
+    return 1;
+  }
+
+  std::signal(SIGINT, [](int) { sQuit = true; });
+  std::signal(SIGTERM, [](int) { sQuit = true; });
+
+  MySynthEngine engine(kNumVoices);
+  engine.mRecorder.SetEnabled(!options.mRecordPath.empty());
+  engine.SetDeterministic(options.mDeterministic);
+  engine.SetSampleRateAndBlockSize(options.mSampleRate, options.mBlockSize);
+  engine.ApplyVoiceSettings(options.mVoiceSettings, 0);
+  engine.SetRetriggerMode(options.mRetriggerMode);
+
+  std::vector<sample> outputBuffer((size_t) kNumOutputs * options.mBlockSize);
+  sample* outputs[kNumOutputs];
+
+  for (int c = 0; c < kNumOutputs; c++)
+    outputs[c] = outputBuffer.data() + (size_t) c * options.mBlockSize;
+
+  using Clock = std::chrono::steady_clock;
+  const Clock::time_point startTime = Clock::now();
+  const std::chrono::duration<double> blockPeriod(options.mBlockSize / options.mSampleRate);
+  Clock::time_point blockDue = startTime;
+
+  SoakStats stats;
+  int64_t frame = 0;
+  int64_t songPos = 0; // position within the current pass of the MIDI file
+  size_t nextEvent = 0;
+  int64_t nextReport = (int64_t) (kReportIntervalSeconds * options.mSampleRate);
+
+  while (!sQuit && (totalFrames < 0 || frame < totalFrames))
+  {
+    const int nFrames = totalFrames < 0 ? options.mBlockSize : (int) std::min<int64_t>(options.mBlockSize, totalFrames - frame);
+
+    if (options.mRealtime)
+    {
+      // a real driver calls back once per period, so wait for the simulated clock to reach this block
+      std::this_thread::sleep_until(blockDue);
+      blockDue += std::chrono::duration_cast<Clock::duration>(blockPeriod);
+    }
+
+    const Clock::time_point blockStart = Clock::now();
+
+    udpInput.Poll([&](const IMidiMsg& msg) { engine.ProcessMidiMsg(msg); });
+
+    for (int s = 0; s < nFrames;)
+    {
+      while (nextEvent < midiEvents.size() && midiEvents[nextEvent].mSampleTime < songPos + (nFrames - s))
+      {
+        const TimedMidiMsg& e = midiEvents[nextEvent++];
+        engine.ProcessMidiMsg(IMidiMsg(s + (int) std::max<int64_t>(e.mSampleTime - songPos, 0), e.mStatus, e.mData1, e.mData2));
+      }
+
+      // wrap the song within the block if looping
+      const int64_t toSongEnd = songFrames - songPos;
+
+      if (options.mLoop && songFrames > 0 && toSongEnd <= nFrames - s)
+      {
+        s += (int) toSongEnd;
+        songPos = 0;
+        nextEvent = 0;
+      }
+      else
+      {
+        songPos += nFrames - s;
+        s = nFrames;
+      }
+    }
+
+    engine.ProcessBlock(outputs, nFrames);
+    memcpy(outputs[1], outputs[0], nFrames * sizeof(sample));
+
+    const double blockSeconds = std::chrono::duration<double>(Clock::now() - blockStart).count();
+    stats.mNBlocks++;
+    stats.mTotalBlockSeconds += blockSeconds;
+    stats.mMaxBlockSeconds = std::max(stats.mMaxBlockSeconds, blockSeconds);
+
+    // the block has to be ready before the driver asks for the next one
+    if (options.mRealtime && Clock::now() > blockDue)
+      stats.mNMissedDeadlines++;
+
+    for (int s = 0; s < nFrames; s++)
+    {
+      const double v = outputs[0][s];
+
+      if (!std::isfinite(v))
+        stats.mNNonFinite++;
+      else
+        stats.mPeak = std::max(stats.mPeak, std::fabs(v));
+    }
+
+    if (options.mFileDriver)
+      wavFile.Write(outputs, nFrames);
+
+    frame += nFrames;
+
+    if (frame >= nextReport)
+    {
+      stats.Print(frame, options, std::chrono::duration<double>(Clock::now() - startTime).count());
+      nextReport += (int64_t) (kReportIntervalSeconds * options.mSampleRate);
+    }
+  }
+
+  stats.Print(frame, options, std::chrono::duration<double>(Clock::now() - startTime).count());
+
+  if (!options.mRecordPath.empty() && !BlackBoxRecorder::Write(options.mRecordPath.c_str(), engine.mRecorder.Snapshot()))
+    fprintf(stderr, "could not write %s\n", options.mRecordPath.c_str());
+
+  return stats.mNNonFinite ? 2 : 0;
+}
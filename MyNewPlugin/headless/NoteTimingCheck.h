@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "MySynthEngine.h"
+#include "MidiFile.h"
+
+/** One case of RunNoteTimingCheck(): a few messages that all fall inside the first slice, where quantizing them could reorder them */
+struct NoteTimingCase
+{
+  const char* mName;
+  std::vector<TimedMidiMsg> mEvents;
+  int64_t mFirstSoundFrame; // nothing may sound before this
+  bool mAudible; // a note with no length may end before its envelope has produced anything
+  bool mSustained; // whether a voice should still be sounding at the end
+};
+
+/** Plays notes that start and end within one slice, and checks that none of them gets stuck: each case is rendered in normal and deterministic mode,
+ * then every voice must have finished its release, and nothing may sound before the note-on
+ * @return The number of cases that fail */
+static int RunNoteTimingCheck(const MySynthVoiceSettings& settings, double sampleRate, int blockSize, int nVoices)
+{
+  const std::vector<NoteTimingCase> cases = {
+    {"on/off in one slice", {{3, 0x90, 60, 100}, {10, 0x80, 60, 0}}, 3, true, false},
+    {"zero length note", {{5, 0x90, 62, 100}, {5, 0x80, 62, 0}}, 5, false, false},
+    {"velocity 0 note-off", {{3, 0x90, 64, 100}, {10, 0x90, 64, 0}}, 3, true, false},
+    {"retrigger and off in one slice", {{1, 0x90, 65, 100}, {4, 0x80, 65, 0}, {7, 0x90, 65, 90}, {12, 0x80, 65, 0}}, 1, true, false},
+    {"pedal before off in one slice", {{2, 0xB0, 64, 127}, {4, 0x90, 67, 100}, {9, 0x80, 67, 0}}, 4, true, true},
+  };
+
+  const int64_t nFrames = (int64_t) ((settings.mAttackMs + settings.mDecayMs + settings.mReleaseMs) / 1000. * sampleRate) + (int64_t) sampleRate;
+  int nFailures = 0;
+
+  for (const NoteTimingCase& c : cases)
+  {
+    for (int deterministic = 0; deterministic < 2; deterministic++)
+    {
+      MySynthEngine engine(nVoices);
+      engine.SetDeterministic(deterministic);
+      engine.SetSampleRateAndBlockSize(sampleRate, blockSize);
+      engine.ApplyVoiceSettings(settings, 0);
+
+      std::vector<sample> output((size_t) nFrames);
+      size_t nextEvent = 0;
+
+      for (int64_t pos = 0; pos < nFrames; pos += blockSize)
+      {
+        const int nBlockFrames = (int) std::min<int64_t>(blockSize, nFrames - pos);
+
+        for (; nextEvent < c.mEvents.size() && c.mEvents[nextEvent].mSampleTime < pos + nBlockFrames; nextEvent++)
+        {
+          const TimedMidiMsg& e = c.mEvents[nextEvent];
+          engine.ProcessMidiMsg(IMidiMsg((int) (e.mSampleTime - pos), e.mStatus, e.mData1, e.mData2));
+        }
+
+        sample* pBlock = output.data() + pos;
+        engine.ProcessBlock(&pBlock, nBlockFrames);
+      }
+
+      const auto firstSound = std::find_if(output.begin(), output.end(), [](sample v) { return v != 0.; });
+      const int64_t firstSoundFrame = firstSound == output.end() ? -1 : firstSound - output.begin();
+      const bool sounding = std::any_of(engine.mVoices.begin(), engine.mVoices.end(), [](const MySynthVoice* pVoice) { return pVoice->GetBusy(); });
+      const bool early = firstSoundFrame >= 0 && firstSoundFrame < c.mFirstSoundFrame;
+      const bool passed = (firstSoundFrame >= 0 || !c.mAudible) && !early && sounding == c.mSustained;
+
+      printf("%-32s %-13s %s", c.mName, deterministic ? "deterministic" : "normal", passed ? "ok" : "FAILED");
+
+      if (!passed)
+        printf(" (first sound at %lld, expected %lld, %s at the end)", (long long) firstSoundFrame, (long long) c.mFirstSoundFrame, sounding ? "still sounding" : "silent");
+
+      printf("\n");
+      nFailures += !passed;
+    }
+  }
+
+  fflush(stdout);
+  return nFailures;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "MySynthEngine.h"
+
+/** One case of RunPresetChangeCheck(): a note played with one set of voice settings, which change to another while it is in a given stage */
+struct PresetChangeCase
+{
+  const char* mName;
+  MySynthVoiceSettings mFrom;
+  MySynthVoiceSettings mTo;
+  double mReleaseMs; // when the note is released, < 0 to hold it
+  double mChangeMs; // when the settings change
+};
+
+/** Renders one case a sample at a block, as the plug-in applies a preset at a block boundary, and returns the voice's envelope at every sample */
+static std::vector<double> RenderPresetChange(const PresetChangeCase& c, double sampleRate, int nVoices, int rampSamples, int64_t nFrames)
+{
+  MySynthEngine engine(nVoices);
+  engine.SetSampleRateAndBlockSize(sampleRate, 1);
+  engine.ApplyVoiceSettings(c.mFrom, 0);
+
+  const int64_t releaseFrame = c.mReleaseMs < 0. ? -1 : (int64_t) (c.mReleaseMs / 1000. * sampleRate);
+  const int64_t changeFrame = (int64_t) (c.mChangeMs / 1000. * sampleRate);
+  std::vector<double> envelope((size_t) nFrames);
+  sample output = 0.;
+  sample* pOutput = &output;
+
+  engine.ProcessMidiMsg(IMidiMsg(0, 0x90, 60, 100));
+
+  for (int64_t pos = 0; pos < nFrames; pos++)
+  {
+    if (pos == releaseFrame)
+      engine.ProcessMidiMsg(IMidiMsg(0, 0x80, 60, 0));
+
+    if (pos == changeFrame)
+      engine.ApplyVoiceSettings(c.mTo, rampSamples);
+
+    output = 0.;
+    engine.ProcessBlock(&pOutput, 1);
+
+    const auto pVoice = std::find_if(engine.mVoices.begin(), engine.mVoices.end(), [](const MySynthVoice* pVoice) { return pVoice->GetBusy(); });
+    envelope[(size_t) pos] = pVoice == engine.mVoices.end() ? 0. : (*pVoice)->mEnv.GetPrevOutput();
+  }
+
+  return envelope;
+}
+
+/** The largest change from one sample to the next (order 1), or in that change (order 2), over [start, end) */
+static double MaxDifference(const std::vector<double>& values, int64_t start, int64_t end, int order)
+{
+  double maxDiff = 0.;
+
+  for (int64_t i = std::max<int64_t>(start, order); i < std::min<int64_t>(end, (int64_t) values.size()); i++)
+  {
+    const double diff = order == 1 ? values[i] - values[i - 1] : values[i] - 2. * values[i - 1] + values[i - 2];
+    maxDiff = std::max(maxDiff, std::fabs(diff));
+  }
+
+  return maxDiff;
+}
+
+/** Changes the voice settings while a note is in each stage of its envelope, with the plug-in's preset crossfade, and checks that the envelope
+ * carries on smoothly: it may not step by more than switching the settings instantly does, and the kink where its speed changes must be spread
+ * over the crossfade, so no sharper than an eighth of the instant switch's
+ * @return The number of cases that fail */
+static int RunPresetChangeCheck(double sampleRate, int nVoices, double crossfadeMs)
+{
+  MySynthVoiceSettings slow;
+  slow.mAttackMs = 2000.;
+  slow.mDecayMs = 2000.;
+  slow.mSustainLevel = 0.8;
+  slow.mReleaseMs = 2000.;
+
+  MySynthVoiceSettings fast = slow;
+  fast.mAttackMs = 200.;
+  fast.mDecayMs = 200.;
+  fast.mSustainLevel = 0.2;
+  fast.mReleaseMs = 200.;
+
+  MySynthVoiceSettings quick = slow; // gets to the later stages quickly
+  quick.mAttackMs = 1.;
+  quick.mDecayMs = 1.;
+
+  MySynthVoiceSettings quickFast = fast;
+  quickFast.mAttackMs = 1.;
+  quickFast.mDecayMs = 1.;
+
+  MySynthVoiceSettings quickDecay = quick;
+  quickDecay.mDecayMs = 2000.;
+
+  MySynthVoiceSettings quickDecayFast = quickDecay; // only the rate changes, the sustain case covers the level
+  quickDecayFast.mDecayMs = 200.;
+
+  const std::vector<PresetChangeCase> cases = {
+    {"attack", slow, fast, -1., 100.},
+    {"decay", quickDecay, quickDecayFast, -1., 50.},
+    {"sustain", quick, quickFast, -1., 100.},
+    {"release", quick, quickFast, 20., 60.},
+  };
+
+  const int rampSamples = (int) (crossfadeMs / 1000. * sampleRate);
+  int nFailures = 0;
+
+  for (const PresetChangeCase& c : cases)
+  {
+    const int64_t changeFrame = (int64_t) (c.mChangeMs / 1000. * sampleRate);
+    const int64_t nFrames = changeFrame + 2 * rampSamples;
+    const std::vector<double> instant = RenderPresetChange(c, sampleRate, nVoices, 0, nFrames);
+    const std::vector<double> crossfaded = RenderPresetChange(c, sampleRate, nVoices, rampSamples, nFrames);
+
+    // the window starts a little before the change, since settings applied at a block boundary take effect on the next sample
+    const int64_t start = changeFrame - 2;
+    const int64_t end = changeFrame + rampSamples + 2;
+    const double instantStep = MaxDifference(instant, start, end, 1);
+    const double instantKink = MaxDifference(instant, start, end, 2);
+    const double step = MaxDifference(crossfaded, start, end, 1);
+    const double kink = MaxDifference(crossfaded, start, end, 2);
+    const bool passed = crossfaded[(size_t) changeFrame] > 0. && step <= instantStep * (1. + 1e-9) && kink <= instantKink / 8.;
+
+    printf("%-8s largest step %.3g (instant %.3g), sharpest kink %.3g (instant %.3g) %s\n", c.mName, step, instantStep, kink, instantKink,
+           passed ? "ok" : "FAILED");
+    nFailures += !passed;
+  }
+
+  fflush(stdout);
+  return nFailures;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/** Streams interleaved 32-bit float audio to a .wav file. The header sizes are patched when the file is closed,
+ *  so a long soak run can be written without holding the audio in memory. */
+class WavFileWriter
+{
+public:
+  ~WavFileWriter()
+  {
+    Close();
+  }
+
+  bool Open(const char* path, int nChannels, double sampleRate)
+  {
+    Close();
+    mFile = fopen(path, "wb");
+
+    if (!mFile)
+      return false;
+
+    mNChannels = nChannels;
+    mDataBytes = 0;
+    WriteHeader((uint32_t) sampleRate);
+    return true;
+  }
+
+  bool IsOpen() const { return mFile != nullptr; }
+
+  /** Write a block of non-interleaved channels
+   * @param channels nChannels pointers to nFrames samples */
+  template <typename T>
+  void Write(T** channels, int nFrames)
+  {
+    if (!mFile)
+      return;
+
+    mInterleaved.resize((size_t) nFrames * mNChannels);
+
+    for (int s = 0; s < nFrames; s++)
+      for (int c = 0; c < mNChannels; c++)
+        mInterleaved[(size_t) s * mNChannels + c] = (float) channels[c][s];
+
+    mDataBytes += (uint32_t) fwrite(mInterleaved.data(), sizeof(float), mInterleaved.size(), mFile) * sizeof(float);
+  }
+
+  void Close()
+  {
+    if (!mFile)
+      return;
+
+    fseek(mFile, 4, SEEK_SET);
+    Put32(36 + mDataBytes);
+    fseek(mFile, 40, SEEK_SET);
+    Put32(mDataBytes);
+    fclose(mFile);
+    mFile = nullptr;
+  }
+
+private:
+  void WriteHeader(uint32_t sampleRate)
+  {
+    const uint16_t blockAlign = (uint16_t) (mNChannels * sizeof(float));
+
+    fwrite("RIFF", 1, 4, mFile);
+    Put32(36); // patched in Close()
+    fwrite("WAVEfmt ", 1, 8, mFile);
+    Put32(16);
+    Put16(3); // WAVE_FORMAT_IEEE_FLOAT
+    Put16((uint16_t) mNChannels);
+    Put32(sampleRate);
+    Put32(sampleRate * blockAlign);
+    Put16(blockAlign);
+    Put16(32);
+    fwrite("data", 1, 4, mFile);
+    Put32(0); // patched in Close()
+  }
+
+  void Put32(uint32_t v)
+  {
+    const uint8_t b[4] = {(uint8_t) v, (uint8_t) (v >> 8), (uint8_t) (v >> 16), (uint8_t) (v >> 24)};
+    fwrite(b, 1, 4, mFile);
+  }
+
+  void Put16(uint16_t v)
+  {
+    const uint8_t b[2] = {(uint8_t) v, (uint8_t) (v >> 8)};
+    fwrite(b, 1, 2, mFile);
+  }
+
+  FILE* mFile = nullptr;
+  int mNChannels = 0;
+  uint32_t mDataBytes = 0;
+  std::vector<float> mInterleaved;
+};
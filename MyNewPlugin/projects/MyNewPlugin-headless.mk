@@ -0,0 +1,33 @@
+# Headless Linux build of the synth's DSP, for soak testing on build machines (no editor, no audio device)
+# It runs MySynthEngine rather than the MyNewPlugin class, see the comment at the top of headless/MyNewPlugin-headless.cpp for what that leaves out
+# usage, from this folder: make -f MyNewPlugin-headless.mk
+
+# IPLUG2_ROOT should point to the top level IPLUG2 folder from the project folder
+IPLUG2_ROOT = ../../iPlug2
+
+PROJECT_ROOT = ..
+
+TARGET = ../build-linux/MyNewPlugin-headless
+
+SRC = $(PROJECT_ROOT)/headless/MyNewPlugin-headless.cpp \
+$(PROJECT_ROOT)/MidiSynth.cpp
+
+CXX ?= g++
+CXXFLAGS += -std=c++17 -O2 -g -Wall -DNDEBUG \
+-I$(PROJECT_ROOT) \
+-I$(IPLUG2_ROOT)/IPlug \
+-I$(IPLUG2_ROOT)/IPlug/Extras \
+-I$(IPLUG2_ROOT)/WDL
+# no fused multiply-adds, so that deterministic renders match between machines with and without FMA
+CXXFLAGS += -ffp-contract=off
+CXXFLAGS += $(EXTRA_CFLAGS)
+LDFLAGS += -lpthread
+
+$(TARGET): $(SRC) $(wildcard $(PROJECT_ROOT)/*.h) $(wildcard $(PROJECT_ROOT)/headless/*.h)
+	mkdir -p $(dir $@)
+	$(CXX) $(CXXFLAGS) -o $@ $(SRC) $(LDFLAGS)
+
+clean:
+	rm -f $(TARGET)
+
+.PHONY: clean
@@ -0,0 +1,32 @@
+# Shared library with a C interface to the synth engine, loaded by python/mynewplugin_synth.py
+# usage, from this folder: make -f MyNewPlugin-python.mk
+
+# IPLUG2_ROOT should point to the top level IPLUG2 folder from the project folder
+IPLUG2_ROOT = ../../iPlug2
+
+PROJECT_ROOT = ..
+
+TARGET = ../build-linux/libMyNewPluginSynth.so
+
+SRC = $(PROJECT_ROOT)/python/MyNewPluginSynth.cpp \
+$(PROJECT_ROOT)/MidiSynth.cpp
+
+CXX ?= g++
+CXXFLAGS += -std=c++17 -O2 -fPIC -fvisibility=hidden -Wall -DNDEBUG \
+-I$(PROJECT_ROOT) \
+-I$(IPLUG2_ROOT)/IPlug \
+-I$(IPLUG2_ROOT)/IPlug/Extras \
+-I$(IPLUG2_ROOT)/WDL
+# no fused multiply-adds, so that deterministic renders match between machines with and without FMA
+CXXFLAGS += -ffp-contract=off
+CXXFLAGS += $(EXTRA_CFLAGS)
+LDFLAGS += -shared -lpthread
+
+$(TARGET): $(SRC) $(wildcard $(PROJECT_ROOT)/*.h) $(wildcard $(PROJECT_ROOT)/python/*.h)
+	mkdir -p $(dir $@)
+	$(CXX) $(CXXFLAGS) -o $@ $(SRC) $(LDFLAGS)
+
+clean:
+	rm -f $(TARGET)
+
+.PHONY: clean
@@ -0,0 +1,120 @@
+#include "MyNewPluginSynth.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include "MySynthEngine.h"
+
+using namespace iplug;
+
+static constexpr int kNumVoices = 32; // as in the plug-in
+
+struct MNPSynth
+{
+  MNPSynth(double sampleRate, int blockSize)
+  : mEngine(kNumVoices)
+  , mBlockSize(blockSize)
+  {
+    mEngine.SetDeterministic(true); // so a dataset doesn't depend on the block size it was rendered with
+    mEngine.SetSampleRateAndBlockSize(sampleRate, blockSize);
+  }
+
+  struct Event
+  {
+    int64_t mTime;
+    IMidiMsg mMsg;
+  };
+
+  MySynthEngine mEngine;
+  MySynthVoiceSettings mSettings;
+  int mBlockSize;
+  std::vector<Event> mEvents; // kept between renders, so that repeated renders of similar note lists don't allocate
+};
+
+int mnp_synth_sample_size(void)
+{
+  return (int) sizeof(sample);
+}
+
+MNPSynth* mnp_synth_create(double sampleRate, int blockSize)
+{
+  if (sampleRate <= 0. || blockSize <= 0)
+    return nullptr;
+
+  return new (std::nothrow) MNPSynth(sampleRate, blockSize);
+}
+
+void mnp_synth_destroy(MNPSynth* pSynth)
+{
+  delete pSynth;
+}
+
+int mnp_synth_set_param(MNPSynth* pSynth, const char* name, double value)
+{
+  if (!strcmp(name, "attack")) pSynth->mSettings.mAttackMs = value;
+  else if (!strcmp(name, "decay")) pSynth->mSettings.mDecayMs = value;
+  else if (!strcmp(name, "sustain")) pSynth->mSettings.mSustainLevel = value / 100.;
+  else if (!strcmp(name, "release")) pSynth->mSettings.mReleaseMs = value;
+  else return -1;
+
+  return 0;
+}
+
+int mnp_synth_render(MNPSynth* pSynth, const MNPNote* notes, int nNotes, void* output, int64_t nFrames)
+{
+  if (!pSynth || !output || nFrames < 0 || (nNotes && !notes))
+    return -1;
+
+  for (int n = 0; n < nNotes; n++)
+  {
+    // velocity 0 would be a note-off
+    if (notes[n].pitch < 0 || notes[n].pitch > 127 || notes[n].velocity < 1 || notes[n].velocity > 127)
+      return -1;
+  }
+
+  MySynthEngine& engine = pSynth->mEngine;
+  auto& events = pSynth->mEvents;
+
+  engine.Reset();
+  engine.ApplyVoiceSettings(pSynth->mSettings, 0);
+
+  events.clear();
+
+  for (int n = 0; n < nNotes; n++)
+  {
+    const MNPNote& note = notes[n];
+    IMidiMsg on, off;
+    on.MakeNoteOnMsg(note.pitch, note.velocity, 0);
+    off.MakeNoteOffMsg(note.pitch, 0);
+    events.push_back({note.start, on});
+    events.push_back({note.start + std::max<int64_t>(note.length, 1), off}); // a note with no length still gets a sample, rather than its off overtaking its on
+  }
+
+  // note-offs before note-ons at the same time, so a repeated key retriggers rather than being cut off. As every note lasts at least a sample,
+  // an off is never at the same time as its own on, so this only ever orders the off of one note before the on of another
+  std::stable_sort(events.begin(), events.end(), [](const MNPSynth::Event& a, const MNPSynth::Event& b) {
+    return a.mTime < b.mTime || (a.mTime == b.mTime && a.mMsg.StatusMsg() == IMidiMsg::kNoteOff && b.mMsg.StatusMsg() != IMidiMsg::kNoteOff);
+  });
+
+  sample* pOutput = static_cast<sample*>(output);
+  size_t nextEvent = 0;
+
+  for (int64_t pos = 0; pos < nFrames; pos += pSynth->mBlockSize)
+  {
+    const int nBlockFrames = (int) std::min<int64_t>(pSynth->mBlockSize, nFrames - pos);
+
+    for (; nextEvent < events.size() && events[nextEvent].mTime < pos + nBlockFrames; nextEvent++)
+    {
+      IMidiMsg msg = events[nextEvent].mMsg;
+      msg.mOffset = (int) std::max<int64_t>(events[nextEvent].mTime - pos, 0);
+      engine.ProcessMidiMsg(msg);
+    }
+
+    sample* pBlock = pOutput + pos;
+    engine.ProcessBlock(&pBlock, nBlockFrames);
+  }
+
+  return 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+/**
+ * @file
+ * A plain C interface to MySynthEngine for offline batch rendering from other languages (see mynewplugin_synth.py).
+ * Each handle is an isolated engine. A handle must only be used by one thread at a time, but different handles can render concurrently.
+ */
+
+#include <stdint.h>
+
+#ifdef _WIN32
+  #define MNP_SYNTH_API __declspec(dllexport)
+#else
+  #define MNP_SYNTH_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** A note to render, in samples from the start of the render */
+typedef struct MNPNote
+{
+  int64_t start;
+  int64_t length; /* note-off is sent at start + length, and at least one sample after the note-on */
+  int32_t pitch; /* 0 to 127 */
+  int32_t velocity; /* 1 to 127 */
+} MNPNote;
+
+typedef struct MNPSynth MNPSynth;
+
+/** @return The size in bytes of one output sample: 8 if the engine renders doubles, 4 if it was built with SAMPLE_TYPE_FLOAT */
+MNP_SYNTH_API int mnp_synth_sample_size(void);
+
+MNP_SYNTH_API MNPSynth* mnp_synth_create(double sampleRate, int blockSize);
+
+MNP_SYNTH_API void mnp_synth_destroy(MNPSynth* pSynth);
+
+/** Set a parameter, in the plug-in's units
+ * @param name "attack", "decay" or "release" in ms, or "sustain" in %
+ * @return 0 on success, -1 if the name is unknown */
+MNP_SYNTH_API int mnp_synth_set_param(MNPSynth* pSynth, const char* name, double value);
+
+/** Render notes into a caller-provided mono buffer, starting from silence. The engine writes straight into the buffer, block by block.
+ * @param notes nNotes notes, in any order
+ * @param output nFrames samples of mnp_synth_sample_size() bytes each
+ * @return 0 on success, -1 if an argument is invalid, including a note with a pitch or velocity out of range, in which case nothing is rendered */
+MNP_SYNTH_API int mnp_synth_render(MNPSynth* pSynth, const MNPNote* notes, int nNotes, void* output, int64_t nFrames);
+
+#ifdef __cplusplus
+}
+#endif
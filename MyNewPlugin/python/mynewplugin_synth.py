@@ -0,0 +1,133 @@
+"""
+Batch rendering of MyNewPlugin's synth engine from Python.
+
+Renders go straight into NumPy arrays owned by the caller, with no intermediate copies, and the GIL is released
+for the duration of each render (ctypes drops it around every foreign call), so renders on different Synth objects
+run in parallel when driven from a thread pool:
+
+    from concurrent.futures import ThreadPoolExecutor
+    import numpy as np
+    import mynewplugin_synth as mnp
+
+    def render(params):
+        synth = mnp.Synth(sample_rate=44100)
+        out = np.empty(44100 * 2, dtype=synth.dtype)
+        return synth.render([(0.0, 1.0, 60, 100)], params, out=out)
+
+    with ThreadPoolExecutor() as pool:
+        renders = list(pool.map(render, [{"attack": a, "release": 200} for a in range(1, 500)]))
+
+Build the shared library with projects/MyNewPlugin-python.mk; set MNP_SYNTH_LIB to load it from somewhere else.
+"""
+
+import ctypes
+import os
+
+import numpy as np
+
+# matches MNPNote in MyNewPluginSynth.h; a NumPy array of this dtype is passed to the engine without conversion
+NOTE_DTYPE = np.dtype([("start", np.int64), ("length", np.int64), ("pitch", np.int32), ("velocity", np.int32)], align=True)
+
+PARAM_NAMES = ("attack", "decay", "sustain", "release")
+
+_DEFAULT_LIB = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "build-linux", "libMyNewPluginSynth.so")
+
+
+def _load_library():
+    lib = ctypes.CDLL(os.environ.get("MNP_SYNTH_LIB", _DEFAULT_LIB))
+    lib.mnp_synth_sample_size.restype = ctypes.c_int
+    lib.mnp_synth_sample_size.argtypes = []
+    lib.mnp_synth_create.restype = ctypes.c_void_p
+    lib.mnp_synth_create.argtypes = [ctypes.c_double, ctypes.c_int]
+    lib.mnp_synth_destroy.restype = None
+    lib.mnp_synth_destroy.argtypes = [ctypes.c_void_p]
+    lib.mnp_synth_set_param.restype = ctypes.c_int
+    lib.mnp_synth_set_param.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_double]
+    lib.mnp_synth_render.restype = ctypes.c_int
+    lib.mnp_synth_render.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_int64]
+    return lib
+
+
+_lib = _load_library()
+
+
+class Synth:
+    """One isolated engine. Use one Synth per thread."""
+
+    def __init__(self, sample_rate=44100.0, block_size=512):
+        self.sample_rate = float(sample_rate)
+        self.dtype = np.dtype(np.float64 if _lib.mnp_synth_sample_size() == 8 else np.float32)
+        self._handle = _lib.mnp_synth_create(self.sample_rate, int(block_size))
+
+        if not self._handle:
+            raise ValueError("invalid sample rate or block size")
+
+    def close(self):
+        if self._handle:
+            _lib.mnp_synth_destroy(self._handle)
+            self._handle = None
+
+    def __del__(self):
+        self.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def set_params(self, params):
+        """Set parameters from a dict, in the plug-in's units: attack/decay/release in ms, sustain in %."""
+        for name, value in params.items():
+            if _lib.mnp_synth_set_param(self._handle, name.encode("ascii"), float(value)) != 0:
+                raise KeyError("unknown parameter %r, expected one of %s" % (name, ", ".join(PARAM_NAMES)))
+
+    def notes_to_array(self, notes):
+        """Convert (start_seconds, length_seconds, pitch, velocity) tuples to a NOTE_DTYPE array."""
+        notes = list(notes)
+        array = np.empty(len(notes), dtype=NOTE_DTYPE)
+
+        for i, (start, length, pitch, velocity) in enumerate(notes):
+            array[i] = (round(start * self.sample_rate), round(length * self.sample_rate), pitch, velocity)
+
+        return array
+
+    def render(self, notes, params=None, out=None, n_frames=None):
+        """
+        Render notes from silence into a mono buffer.
+
+        notes: a NOTE_DTYPE array (times in samples), or an iterable of (start_seconds, length_seconds, pitch, velocity)
+        params: optional dict of parameters, applied before rendering and kept for later renders
+        out: optional 1-D C-contiguous writable array of self.dtype; rendered into in place
+        n_frames: length of the render when out is not given; defaults to the end of the last note plus one second
+        """
+        if params:
+            self.set_params(params)
+
+        if not (isinstance(notes, np.ndarray) and notes.dtype == NOTE_DTYPE):
+            notes = self.notes_to_array(notes)
+
+        notes = np.ascontiguousarray(notes)
+
+        if len(notes) and ((notes["pitch"] < 0).any() or (notes["pitch"] > 127).any()):
+            raise ValueError("note pitches must be from 0 to 127")
+
+        if len(notes) and ((notes["velocity"] < 1).any() or (notes["velocity"] > 127).any()):
+            raise ValueError("note velocities must be from 1 to 127")
+
+        if out is None:
+            if n_frames is None:
+                end = int((notes["start"] + notes["length"]).max()) if len(notes) else 0
+                n_frames = end + int(self.sample_rate)
+
+            out = np.empty(int(n_frames), dtype=self.dtype)
+        elif out.dtype != self.dtype or out.ndim != 1 or not out.flags.c_contiguous or not out.flags.writeable:
+            raise ValueError("out must be a writable, C-contiguous 1-D array of %s" % self.dtype)
+
+        result = _lib.mnp_synth_render(self._handle, notes.ctypes.data_as(ctypes.c_void_p), len(notes),
+                                       out.ctypes.data_as(ctypes.c_void_p), out.shape[0])
+
+        if result != 0:
+            raise RuntimeError("render failed")
+
+        return out
@@ -0,0 +1,145 @@
+#!/usr/bin/env node
+
+// benchmark-wam.js runs the WAM processor module headless in node, calling wam_onprocess in a loop the way the AudioWorklet does,
+// and reports how many times faster than realtime it renders
+// usage: node benchmark-wam.js [--seconds 30] [--sr 48000] [--voices 8] module-wam.js [another-wam.js ...]
+//
+// to compare a release build with the default one, from the projects folder:
+//   emmake make --makefile MyNewPlugin-wam-processor.mk TARGET=../build-web/MyNewPlugin-wam-debug.js
+//   emmake make --makefile MyNewPlugin-wam-processor.mk TARGET=../build-web/MyNewPlugin-wam-release.js WAM_RELEASE=1
+//   node ../scripts/benchmark-wam.js ../build-web/MyNewPlugin-wam-debug.js ../build-web/MyNewPlugin-wam-release.js
+
+const fs = require('fs');
+const path = require('path');
+const vm = require('vm');
+
+const PROJECT_NAME = 'MyNewPlugin';
+const BLOCK_SIZE = 128; // a render quantum
+const NUM_OUTPUT_CHANNELS = 2;
+
+function parseArgs(argv) {
+  const args = { seconds: 30, sr: 48000, voices: 8, modules: [] };
+
+  for (let i = 0; i < argv.length; i++) {
+    switch (argv[i]) {
+      case '--seconds': args.seconds = parseFloat(argv[++i]); break;
+      case '--sr':      args.sr = parseInt(argv[++i]); break;
+      case '--voices':  args.voices = parseInt(argv[++i]); break;
+      default:          args.modules.push(argv[i]); break;
+    }
+  }
+
+  if (args.modules.length === 0)
+    args.modules.push(path.join(__dirname, '..', 'build-web', 'scripts', `${PROJECT_NAME}-wam.js`));
+
+  return args;
+}
+
+// the module expects to be evaluated in an AudioWorkletGlobalScope, with its Module object at AudioWorkletGlobalScope.WAM.<name>
+function loadModule(file) {
+  const context = vm.createContext({
+    AudioWorkletGlobalScope: { WAM: { [PROJECT_NAME]: {} } },
+    console, performance, atob, TextDecoder, WebAssembly,
+    setTimeout, clearTimeout
+  });
+
+  context.globalThis = context;
+  vm.runInContext(fs.readFileSync(file, 'utf8'), context, { filename: file });
+
+  const WAM = context.AudioWorkletGlobalScope.WAM[PROJECT_NAME];
+
+  return new Promise((resolve) => {
+    if (WAM.calledRun)
+      resolve(WAM);
+    else
+      WAM.onRuntimeInitialized = () => resolve(WAM);
+  });
+}
+
+function benchmark(WAM, args) {
+  const wam_ctor = WAM.cwrap('createModule', 'number', []);
+  const wam_init = WAM.cwrap('wam_init', null, ['number', 'number', 'number', 'string']);
+  const wam_onmidi = WAM.cwrap('wam_onmidi', null, ['number', 'number', 'number', 'number']);
+  const wam_onprocess = WAM.cwrap('wam_onprocess', 'number', ['number', 'number', 'number']);
+  const wam_terminate = WAM.cwrap('wam_terminate', null, ['number']);
+
+  const inst = wam_ctor();
+  wam_init(inst, BLOCK_SIZE, args.sr, '');
+
+  // the same audio bus layout as WAMProcessor: no inputs, one stereo output
+  const obufs = WAM._malloc(NUM_OUTPUT_CHANNELS * 4);
+  const audiobus = WAM._malloc(2 * 4);
+  WAM.setValue(audiobus, 0, 'i32');
+  WAM.setValue(audiobus + 4, obufs, 'i32');
+
+  const outputs = [];
+  for (let c = 0; c < NUM_OUTPUT_CHANNELS; c++) {
+    const buf = WAM._malloc(BLOCK_SIZE * 4);
+    WAM.setValue(obufs + c * 4, buf, 'i32');
+    outputs.push(new Float32Array(BLOCK_SIZE));
+  }
+
+  // a new chord of args.voices notes every half second, held for most of it, so voices are attacking, sustaining and releasing
+  const blocksPerChord = Math.max(1, Math.round(0.5 * args.sr / BLOCK_SIZE));
+  const nBlocks = Math.ceil(args.seconds * args.sr / BLOCK_SIZE);
+  let chord = [];
+  let peak = 0;
+
+  const start = process.hrtime.bigint();
+
+  for (let b = 0; b < nBlocks; b++) {
+    const phase = b % blocksPerChord;
+
+    if (phase === 0) {
+      const root = 36 + (b / blocksPerChord * 5) % 36;
+      chord = [];
+      for (let v = 0; v < args.voices; v++) {
+        chord.push(root + v * 3);
+        wam_onmidi(inst, 0x90, root + v * 3, 100);
+      }
+    }
+    else if (phase === blocksPerChord - (blocksPerChord >> 2)) {
+      for (const note of chord)
+        wam_onmidi(inst, 0x80, note, 0);
+    }
+
+    wam_onprocess(inst, audiobus, 0);
+
+    // copy out like the worklet does, so the benchmark includes the marshalling
+    for (let c = 0; c < NUM_OUTPUT_CHANNELS; c++) {
+      const ptr = WAM.getValue(obufs + c * 4, 'i32') >> 2;
+      outputs[c].set(WAM.HEAPF32.subarray(ptr, ptr + BLOCK_SIZE));
+    }
+
+    for (let s = 0; s < BLOCK_SIZE; s++)
+      peak = Math.max(peak, Math.abs(outputs[0][s]));
+  }
+
+  const seconds = Number(process.hrtime.bigint() - start) / 1e9;
+
+  wam_terminate(inst);
+
+  return { seconds, audioSeconds: nBlocks * BLOCK_SIZE / args.sr, nBlocks, peak };
+}
+
+async function main() {
+  const args = parseArgs(process.argv.slice(2));
+
+  console.log(`${args.seconds} s at ${args.sr} Hz, ${BLOCK_SIZE} frame blocks, ${args.voices} voice chords`);
+
+  for (const file of args.modules) {
+    const WAM = await loadModule(file);
+    const result = benchmark(WAM, args);
+    const usPerBlock = result.seconds * 1e6 / result.nBlocks;
+    const budgetUs = BLOCK_SIZE * 1e6 / args.sr;
+
+    console.log(`${path.basename(file)}: ${result.seconds.toFixed(3)} s, realtime factor ${(result.audioSeconds / result.seconds).toFixed(1)}x, ` +
+                `${usPerBlock.toFixed(1)} us per block (${(100 * usPerBlock / budgetUs).toFixed(1)}% of the ${budgetUs.toFixed(0)} us budget)` +
+                (result.peak === 0 ? ', WARNING: silent output' : ''));
+  }
+}
+
+main().catch((e) => {
+  console.error(e);
+  process.exit(1);
+});
@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+
+# this script builds a memory-mappable preset library (see PresetLibrary.h for the file layout)
+# from a JSON description of the presets:
+#
+# {
+#   "params": 7,
+#   "tags": ["bass", "lead", "pad"],
+#   "presets": [
+#     { "name": "Init", "tags": [], "values": [0, 10, 10, 50, 10, 0, 0] },
+#     ...
+#   ]
+# }
+#
+# USAGE:
+# make_preset_library.py presets.json output.mnpl
+
+import json, struct, sys
+
+VERSION = 2
+MAX_TAGS = 64
+HEADER_FORMAT = "<4s11I"
+ENTRY_FORMAT = "<Q4I"
+
+def sort_key(name):
+  # must match PresetLibrary::CompareNoCase(), which folds ASCII only
+  return name.encode("utf-8").lower()
+
+def main():
+  if len(sys.argv) != 3:
+    print("Usage: make_preset_library.py presets.json output.mnpl")
+    sys.exit(1)
+
+  with open(sys.argv[1], "r") as f:
+    desc = json.load(f)
+
+  nparams = desc["params"]
+  tags = desc.get("tags", [])
+  presets = sorted(desc["presets"], key=lambda p: sort_key(p["name"]))
+
+  if len(tags) > MAX_TAGS:
+    print("error: a library can have at most " + str(MAX_TAGS) + " tags")
+    sys.exit(1)
+
+  entries = b""
+  values = b""
+  strings = b""
+  tagged = [[] for tag in tags] # for each tag, the rows of the presets that have it, ascending
+
+  for row, preset in enumerate(presets):
+    name = preset["name"].encode("utf-8")
+    mask = 0
+    for tag in preset.get("tags", []):
+      if tag not in tags:
+        print("error: preset " + preset["name"] + " uses undeclared tag " + tag)
+        sys.exit(1)
+      mask |= 1 << tags.index(tag)
+
+    for tag in range(len(tags)):
+      if mask >> tag & 1:
+        tagged[tag].append(row)
+
+    vals = list(preset["values"])[:nparams]
+    vals += [0.] * (nparams - len(vals))
+
+    entries += struct.pack(ENTRY_FORMAT, mask, len(strings), len(name), row, 0)
+    values += struct.pack("<" + str(nparams) + "d", *vals)
+    strings += name + b"\0"
+
+  tag_offsets = b""
+  for tag in tags:
+    tag_offsets += struct.pack("<I", len(strings))
+    strings += tag.encode("utf-8") + b"\0"
+
+  tag_index = b""
+  start = 0
+  for rows in tagged:
+    tag_index += struct.pack("<I", start)
+    start += len(rows)
+  tag_index += struct.pack("<I", start)
+  for rows in tagged:
+    tag_index += struct.pack("<" + str(len(rows)) + "I", *rows)
+
+  header_size = struct.calcsize(HEADER_FORMAT)
+  entries_offset = header_size
+  values_offset = entries_offset + len(entries)
+  tag_names_offset = values_offset + len(values)
+  tag_index_offset = tag_names_offset + len(tag_offsets)
+  strings_offset = tag_index_offset + len(tag_index)
+  file_size = strings_offset + len(strings)
+
+  header = struct.pack(HEADER_FORMAT, b"MNPL", VERSION, len(presets), nparams, len(tags),
+                       entries_offset, values_offset, tag_names_offset, strings_offset, len(strings), file_size, tag_index_offset)
+
+  with open(sys.argv[2], "wb") as f:
+    f.write(header + entries + values + tag_offsets + tag_index + strings)
+
+  print("wrote " + str(len(presets)) + " presets to " + sys.argv[2])
+
+if __name__ == '__main__':
+  main()
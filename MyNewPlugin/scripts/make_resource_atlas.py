@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+
+# this script packs the editor's fonts and SVGs into a single memory-mappable resource atlas
+# (see ResourceAtlas.h for the file layout), so that opening the editor maps one file
+# rather than finding and reading each resource separately.
+#
+# resources are packed as raw bytes: fonts as they are, SVGs with their comments, metadata and
+# whitespace between tags removed, which can halve the size of files exported from drawing
+# programs, and null-terminated. Nothing is pre-parsed, the editor still parses every SVG when it opens.
+#
+# prepare_resources-mac.py and prepare_resources-ios.py run it on every build, writing the atlas
+# next to the other resources in the bundle under the name RESOURCE_ATLAS_FN in config.h.
+#
+# USAGE:
+# make_resource_atlas.py output.mnra resources/fonts resources/img [more folders or files...]
+
+import os, re, struct, sys
+
+VERSION = 1
+HEADER_FORMAT = "<4s7I"
+ENTRY_FORMAT = "<4I2Q"
+DATA_ALIGNMENT = 16
+
+# must match ResourceAtlas::EType
+TYPES = { ".ttf": 1, ".otf": 1, ".svg": 2 }
+
+def minify_svg(data):
+  text = data.decode("utf-8")
+  text = re.sub(r"<!--.*?-->", "", text, flags=re.S)
+  text = re.sub(r"<metadata\b.*?</metadata>", "", text, flags=re.S)
+  text = re.sub(r">\s+<", "><", text)
+  return text.strip().encode("utf-8")
+
+def collect(paths):
+  files = {}
+  for path in paths:
+    names = [os.path.join(path, f) for f in sorted(os.listdir(path))] if os.path.isdir(path) else [path]
+    for name in names:
+      ext = os.path.splitext(name)[1].lower()
+      if ext not in TYPES:
+        continue
+      key = os.path.basename(name)
+      if key in files:
+        print("error: " + key + " is in more than one folder")
+        sys.exit(1)
+      files[key] = name
+  return files
+
+def atlas_file_name(projectpath):
+  # the name the plug-in looks for, RESOURCE_ATLAS_FN in config.h
+  with open(os.path.join(projectpath, "config.h")) as f:
+    match = re.search(r'^#define\s+RESOURCE_ATLAS_FN\s+"([^"]+)"', f.read(), flags=re.M)
+  return match.group(1) if match else None
+
+def make_atlas(output, paths):
+  files = collect(paths)
+  names = sorted(files.keys(), key=lambda n: n.encode("utf-8")) # must match ResourceAtlas::Find(), which compares bytes
+
+  header_size = struct.calcsize(HEADER_FORMAT)
+  entries_offset = header_size
+  strings_offset = entries_offset + len(names) * struct.calcsize(ENTRY_FORMAT)
+
+  strings = b""
+  for name in names:
+    strings += name.encode("utf-8") + b"\0"
+
+  data_offset = strings_offset + len(strings)
+  entries = b""
+  blobs = b""
+  name_offset = 0
+  saved = 0
+
+  for name in names:
+    with open(files[name], "rb") as f:
+      data = f.read()
+
+    kind = TYPES[os.path.splitext(name)[1].lower()]
+
+    if kind == 2:
+      minified = minify_svg(data)
+      saved += len(data) - len(minified)
+      data = minified
+
+    padding = -(data_offset + len(blobs)) % DATA_ALIGNMENT
+    blobs += b"\0" * padding
+    entries += struct.pack(ENTRY_FORMAT, name_offset, len(name.encode("utf-8")), kind, 0, data_offset + len(blobs), len(data))
+    blobs += data + b"\0"
+    name_offset += len(name.encode("utf-8")) + 1
+
+  file_size = data_offset + len(blobs)
+  header = struct.pack(HEADER_FORMAT, b"MNRA", VERSION, len(names), entries_offset, strings_offset, len(strings), file_size, 0)
+
+  with open(output, "wb") as f:
+    f.write(header + entries + strings + blobs)
+
+  print("wrote " + str(len(names)) + " resources (" + str(file_size) + " bytes, " + str(saved) + " bytes removed from SVGs) to " + output)
+
+def main():
+  if len(sys.argv) < 3:
+    print("Usage: make_resource_atlas.py output.mnra folder_or_file [folder_or_file...]")
+    sys.exit(1)
+
+  make_atlas(sys.argv[1], sys.argv[2:])
+
+if __name__ == '__main__':
+  main()
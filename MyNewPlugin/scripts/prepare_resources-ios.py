@@ -18,6 +18,10 @@ sys.path.insert(0, os.path.join(os.getcwd(), IPLUG2_ROOT + '/Scripts'))
 
 from parse_config import parse_config, parse_xcconfig
 
+sys.path.insert(0, scriptpath)
+
+import make_resource_atlas
+
 def main():
   if(len(sys.argv) == 2):
      if(sys.argv[1] == "app"):
@@ -37,5 +41,10 @@ def main():
            print("copying " + font + " to " + dst)
            shutil.copy(projectpath + "/resources/fonts/" + font, dst)
 
+       atlas = make_resource_atlas.atlas_file_name(projectpath)
+
+       if atlas:
+         make_resource_atlas.make_atlas(os.path.join(dst, atlas), [p for p in (projectpath + "/resources/fonts/", projectpath + "/resources/img/") if os.path.exists(p)])
+
 if __name__ == '__main__':
   main()
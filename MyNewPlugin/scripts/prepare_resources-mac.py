@@ -17,6 +17,10 @@ sys.path.insert(0, os.path.join(os.getcwd(), IPLUG2_ROOT + '/Scripts'))
 
 from parse_config import parse_config
 
+sys.path.insert(0, scriptpath)
+
+import make_resource_atlas
+
 def main():
   config = parse_config(projectpath)
 
@@ -42,5 +46,11 @@ def main():
       print("copying " + font + " to " + dst)
       shutil.copy(projectpath + "/resources/fonts/" + font, dst)
 
+  # and packed into the atlas the editor loads them from, see make_resource_atlas.py
+  atlas = make_resource_atlas.atlas_file_name(projectpath)
+
+  if atlas:
+    make_resource_atlas.make_atlas(os.path.join(dst, atlas), [p for p in (projectpath + "/resources/fonts/", projectpath + "/resources/img/") if os.path.exists(p)])
+
 if __name__ == '__main__':
   main()